@@ -0,0 +1,116 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ASYNCLOGSINK_H_
+#define ASYNCLOGSINK_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include "Time.hpp"
+
+
+/**
+ * \brief Log sink that writes to a file from a background thread.
+ *
+ * Each thread that logs appends its records, already formatted, to its own lock-free ring buffer,
+ * so that logging never waits for the disk. A background thread drains all the buffers
+ * periodically, or as soon as one of them is half full, and writes the records to the file in
+ * batches, in time order. When a buffer is full, records are either dropped and counted, or the
+ * thread waits for room, depending on the overflow policy. Stopping the sink writes every
+ * pending record before returning.
+ */
+class AsyncLogSink {
+public:
+    /// What a thread does when its buffer is full
+    enum OverflowPolicy {
+        DROP,    ///< Drop the record, and count it
+        BLOCK,   ///< Wait until the background thread makes room for it
+    };
+
+    /**
+     * Opens the log file, in append mode, and starts the background thread.
+     * @param file Path of the log file.
+     * @param bufferSize Number of records that each thread can have pending, rounded up to a power of two.
+     * @param policy What to do with the records that do not fit in a buffer.
+     * @param flushPeriod Maximum time a record waits before being written.
+     */
+    AsyncLogSink(const boost::filesystem::path & file, std::size_t bufferSize, OverflowPolicy policy,
+            Duration flushPeriod = Duration(0.1));
+
+    ~AsyncLogSink() {
+        stop();
+    }
+
+    /**
+     * Appends a record to the buffer of the calling thread, stamped with the current time.
+     * @param category Name of the category, which must live as long as the sink.
+     * @param priority Priority of the record.
+     * @param message Text of the record, without line end.
+     */
+    void append(const std::string & category, int priority, std::string && message);
+
+    /**
+     * Writes all the pending records and stops the background thread. Records appended
+     * afterwards are dropped.
+     */
+    void stop();
+
+    /// Returns the number of records dropped so far.
+    unsigned long int getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    class Buffer;
+
+    Buffer & getLocalBuffer();
+    void run();
+    void drain();
+
+    const std::size_t bufferSize;
+    const OverflowPolicy policy;
+    const Duration flushPeriod;
+    const unsigned int id;                         ///< Identifies this sink in the threads' buffer references
+    boost::filesystem::ofstream file;
+    std::vector<std::shared_ptr<Buffer> > buffers;   ///< The buffers of all the threads that have logged
+    boost::mutex buffersMutex;                       ///< Protects the list of buffers, not their contents
+    boost::mutex wakeMutex;
+    boost::condition wake;                           ///< Wakes the background thread up before its period
+    boost::mutex roomMutex;
+    boost::condition room;                           ///< Wakes the threads waiting for room in their buffers up
+    std::atomic<bool> stopping;                      ///< Set when no more records are accepted
+    std::atomic<bool> finished;                      ///< Set when the background thread must write the last records and exit
+    std::atomic<unsigned int> appending;             ///< Number of threads inside append()
+    std::atomic<unsigned long int> dropped;
+    unsigned long int reportedDropped;               ///< Dropped records already reported in the file
+    boost::thread writer;
+
+    // Non-copyable
+    AsyncLogSink(const AsyncLogSink &);
+    AsyncLogSink & operator=(const AsyncLogSink &);
+};
+
+#endif /* ASYNCLOGSINK_H_ */
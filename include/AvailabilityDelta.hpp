@@ -0,0 +1,195 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AVAILABILITYDELTA_H_
+#define AVAILABILITYDELTA_H_
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <unordered_map>
+#include "BasicMsg.hpp"
+#include "ClusteringList.hpp"
+#include "util/PackedHash.hpp"
+
+
+/**
+ * \brief Changes of the availability information sent through a link.
+ *
+ * A dispatcher sends the changes between the last information it sent through a link and the
+ * new one, instead of the whole new information. The receiver applies them to the information
+ * it received last, which must have the sequence number of the base of the changes.
+ */
+class AvailabilityDelta : public BasicMsg {
+public:
+    AvailabilityDelta() : baseSeq(0), seq(0), fullSize(0) {}
+
+    AvailabilityDelta(uint32_t b, uint32_t s) : baseSeq(b), seq(s), fullSize(0) {}
+
+    /// Returns the sequence number of the information these changes apply to
+    uint32_t getBaseSeq() const {
+        return baseSeq;
+    }
+
+    /// Returns the sequence number of the resulting information
+    uint32_t getSeq() const {
+        return seq;
+    }
+
+    /// Returns the size of the whole information these changes replace, it is not transmitted
+    std::size_t getFullSize() const {
+        return fullSize;
+    }
+
+    /// Sets the size of the whole information these changes replace
+    void setFullSize(std::size_t s) {
+        fullSize = s;
+    }
+
+    /// Returns the class name of the availability information
+    virtual std::string getInfoName() const = 0;
+
+    MSGPACK_DEFINE(baseSeq, seq);
+
+protected:
+    uint32_t baseSeq;       ///< Sequence number of the base information
+    uint32_t seq;           ///< Sequence number of the resulting information
+    std::size_t fullSize;   ///< Size of the whole information, for statistics
+
+    /// Returns whether two objects are packed into the same bytes
+    template<class M> static bool samePacking(const M & l, const M & r) {
+        msgpack::sbuffer lb, rb;
+        msgpack::packer<msgpack::sbuffer> lpk(&lb), rpk(&rb);
+        lpk.pack(l);
+        rpk.pack(r);
+        return lb.size() == rb.size() && std::memcmp(lb.data(), rb.data(), lb.size()) == 0;
+    }
+};
+
+
+/**
+ * \brief Changes of an availability information made of a summary of clusters.
+ *
+ * Clusters that are in both versions are identified by their position in the summary of the
+ * base information, and are not sent; the rest of the clusters of the new version are sent.
+ * The changes also give the order of the new summary, so applying them to the base gives the
+ * same summary as the new version, in the same order. The other fields of the information are
+ * only sent when their packing changes.
+ *
+ * T must define the Cluster type, getSummary, setSummary and reset.
+ */
+template<class T> class SummaryDelta : public AvailabilityDelta {
+public:
+    typedef typename T::Cluster Cluster;
+
+    SummaryDelta() : withHeader(false) {}
+
+    /**
+     * Computes the changes between two versions of the information.
+     * @param base The information the receiver already has.
+     * @param next The new information.
+     */
+    SummaryDelta(const T & base, const T & next) : AvailabilityDelta(base.getSeq(), next.getSeq()), header(next) {
+        // Copies share the clusters of the original, so the headers are built without copying any summary
+        header.setSummary(std::vector<Cluster>());
+        T previous(base);
+        previous.setSummary(std::vector<Cluster>());
+        previous.setSeq(header.getSeq());
+        previous.setFromSch(header.isFromSch());
+        withHeader = !samePacking(header, previous);
+        if (!withHeader)
+            header.reset();
+
+        // The clusters of the base are looked for by the hash of their packing, each one is kept once
+        std::vector<const Cluster *> b;
+        std::unordered_multimap<uint64_t, uint32_t> index;
+        for (auto & c : base.getSummary()) {
+            index.insert(std::make_pair(PackedHash::of(c), b.size()));
+            b.push_back(&c);
+        }
+        for (auto & c : next.getSummary()) {
+            auto candidates = index.equal_range(PackedHash::of(c));
+            auto i = candidates.first;
+            while (i != candidates.second && !(*b[i->second] == c)) ++i;
+            if (i != candidates.second) {
+                order.push_back(i->second + 1);
+                index.erase(i);
+            } else {
+                order.push_back(0);
+                added.push_back(c);
+            }
+        }
+    }
+
+    /**
+     * Applies these changes to the base information.
+     * @param base Information with the base sequence number.
+     * @return The new information, or NULL if the changes do not fit the base.
+     */
+    T * apply(const T & base) const {
+        std::vector<const Cluster *> b;
+        for (auto & c : base.getSummary())
+            b.push_back(&c);
+        std::vector<Cluster> clusters;
+        clusters.reserve(order.size());
+        typename std::vector<Cluster>::const_iterator a = added.begin();
+        for (uint32_t o : order) {
+            if (o == 0) {
+                if (a == added.end()) return NULL;
+                clusters.push_back(*a++);
+            } else {
+                if (o > b.size()) return NULL;
+                clusters.push_back(*b[o - 1]);
+            }
+        }
+        if (a != added.end()) return NULL;
+        T * result = new T(withHeader ? header : base);
+        result->setSummary(std::move(clusters));
+        result->setSeq(seq);
+        return result;
+    }
+
+    /// Returns whether the other fields of the information changed
+    bool hasHeader() const {
+        return withHeader;
+    }
+
+    // This is documented in AvailabilityDelta
+    std::string getInfoName() const {
+        return T::className();
+    }
+
+    // This is documented in BasicMsg
+    void output(std::ostream & os) const {
+        os << baseSeq << "->" << seq << ": " << order.size() - added.size() << " kept, " << added.size() << " added";
+        if (withHeader)
+            os << ", new bounds";
+    }
+
+    MSGPACK_DEFINE((AvailabilityDelta &)*this, withHeader, header, order, added);
+
+private:
+    bool withHeader;                  ///< Whether the fields other than the summary changed
+    T header;                         ///< The new information without summary, when withHeader is true
+    std::vector<uint32_t> order;      ///< For each cluster of the new summary, one plus its position in the base, or zero if it is sent
+    std::vector<Cluster> added;       ///< Clusters that are not in the base, in order
+};
+
+#endif /* AVAILABILITYDELTA_H_ */
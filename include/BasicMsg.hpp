@@ -23,15 +23,24 @@
 
 #include <ostream>
 #include <iomanip>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <atomic>
+#include <stdexcept>
+#include <stdint.h>
 #include <msgpack.hpp>
+#include "util/PackedSize.hpp"
+#include "util/MessagePool.hpp"
 
 /**
  * \brief Basic message class.
  *
  * This is the base class for any message sent through the network. It is received by the CommLayer object and sent
- * to the handler that registered with the message class.
+ * to the handler that registered with the message class. Received messages are owned by a shared_ptr, so handlers
+ * may keep them with shared_from_this() instead of cloning them.
  */
-class BasicMsg {
+class BasicMsg : public std::enable_shared_from_this<BasicMsg> {
 public:
     template<class Message> class MessageRegistrar {
         static BasicMsg * unpackMessage(const msgpack::object & obj) {
@@ -39,19 +48,88 @@ public:
             obj.convert(result);
             return result;
         }
+        static BasicMsg * createMessage() {
+            return new Message();
+        }
     public:
         MessageRegistrar() {
             BasicMsg::unpackerRegistry()[Message::className()] = &unpackMessage;
+            std::vector<Unpacker> & ids = BasicMsg::wireIdRegistry();
+            uint16_t id = Message::wireId();
+            if (ids[id] && ids[id] != &unpackMessage)
+                throw std::logic_error("Message " + Message::className() + " has the same type ID as "
+                        + BasicMsg::wireIdNames()[id]);
+            ids[id] = &unpackMessage;
+            BasicMsg::wireIdNames()[id] = Message::className();
+            std::vector<BasicMsg * (*)()> & factories = BasicMsg::factoryRegistry();
+            unsigned int type = Message::typeIndex();
+            if (type >= factories.size()) factories.resize(type + 1, NULL);
+            factories[type] = &createMessage;
         }
     };
 
-    static BasicMsg * unpackMessage(msgpack::unpacker & pac) {
-        std::string name;
+    /**
+     * Unpacks a message preceded by its type ID, or by its class name if it comes from a peer that
+     * does not know type IDs.
+     * @param pac Unpacker with the message.
+     * @param withId If not null, it is set to whether the message came with a type ID.
+     * @return The new message.
+     * @throw msgpack::type_error if the message class is unknown.
+     */
+    static BasicMsg * unpackMessage(msgpack::unpacker & pac, bool * withId = NULL) {
         msgpack::unpacked msg;
+        Unpacker unpacker;
         pac.next(&msg);
-        msg.get().convert(&name);
+        if (msg.get().type == msgpack::type::POSITIVE_INTEGER) {
+            uint16_t id;
+            msg.get().convert(&id);
+            unpacker = wireIdRegistry()[id];
+        } else {
+            std::string name;
+            msg.get().convert(&name);
+            std::map<std::string, Unpacker>::const_iterator it = unpackerRegistry().find(name);
+            unpacker = it != unpackerRegistry().end() ? it->second : NULL;
+        }
+        if (withId) *withId = msg.get().type == msgpack::type::POSITIVE_INTEGER;
+        if (!unpacker) throw msgpack::type_error();
         pac.next(&msg);
-        return unpackerRegistry()[name](msg.get());
+        return unpacker(msg.get());
+    }
+
+    /**
+     * Computes the type ID of a message class from its name, as a 16-bit FNV-1a hash. It is
+     * stable across builds and versions, and collisions are detected at registration.
+     */
+    static constexpr uint16_t wireIdOf(const char * name, uint32_t hash = 2166136261U) {
+        return *name ? wireIdOf(name + 1, (hash ^ (unsigned char)*name) * 16777619U)
+                : (uint16_t)((hash >> 16) ^ (hash & 0xFFFF));
+    }
+
+    /**
+     * Creates a default-constructed message of a registered class.
+     * @param type Type index of the message class.
+     * @return A new message, or NULL if the class was not registered with REGISTER_MESSAGE.
+     */
+    static BasicMsg * createMessage(unsigned int type) {
+        const std::vector<BasicMsg * (*)()> & factories = factoryRegistry();
+        return type < factories.size() && factories[type] ? factories[type]() : NULL;
+    }
+
+    /**
+     * Returns the number of type indices that may belong to registered classes. Every index
+     * of a registered class is lower than this value.
+     */
+    static unsigned int getNumRegisteredTypes() {
+        return factoryRegistry().size();
+    }
+
+    /**
+     * Returns a new type index. Every message class obtains its own index the first time it
+     * is needed, so that indices are dense and can be used to index tables.
+     */
+    static unsigned int newTypeIndex() {
+        static std::atomic<unsigned int> counter(0);
+        return counter++;
     }
 
     virtual ~BasicMsg() {}
@@ -73,14 +151,75 @@ public:
      */
     virtual std::string getName() const = 0;
 
+    /**
+     * Provides the type index of the class of this message
+     */
+    virtual unsigned int getTypeIndex() const = 0;
+
+    /**
+     * Provides the type ID that identifies the class of this message on the wire
+     */
+    virtual uint16_t getWireId() const = 0;
+
     static std::string className() { return std::string("BasicMsg"); }
 
-    virtual void pack(msgpack::packer<std::ostream> & buffer) = 0;
+    /**
+     * Packs this message preceded by its type ID.
+     */
+    void pack(msgpack::packer<std::ostream> & pk) {
+        pk.pack(getWireId());
+        packBody(pk);
+    }
+
+    /**
+     * Packs this message preceded by its type ID, directly into a buffer that can be handed to
+     * the socket without further copies.
+     */
+    void pack(msgpack::packer<msgpack::sbuffer> & pk) {
+        pk.pack(getWireId());
+        packBody(pk);
+    }
+
+    /**
+     * Packs this message preceded by its class name, for peers that do not know type IDs.
+     */
+    void packWithName(msgpack::packer<msgpack::sbuffer> & pk) {
+        pk.pack(getName());
+        packBody(pk);
+    }
+
+    /**
+     * Returns the number of bytes that pack() produces, without serializing the message.
+     */
+    virtual std::size_t packedSize() const = 0;
+
+    /**
+     * Packs the contents of this message.
+     */
+    virtual void packBody(msgpack::packer<std::ostream> & pk) = 0;
+
+    /**
+     * Packs the contents of this message into a buffer.
+     */
+    virtual void packBody(msgpack::packer<msgpack::sbuffer> & pk) = 0;
 
 private:
     template<class Message> friend class MessageRegistrar;
-    static std::map<std::string, BasicMsg * (*)(const msgpack::object &)> & unpackerRegistry() {
-        static std::map<std::string, BasicMsg * (*)(const msgpack::object &)> instance;
+    typedef BasicMsg * (*Unpacker)(const msgpack::object &);
+    static std::map<std::string, Unpacker> & unpackerRegistry() {
+        static std::map<std::string, Unpacker> instance;
+        return instance;
+    }
+    static std::vector<Unpacker> & wireIdRegistry() {
+        static std::vector<Unpacker> instance(65536, NULL);
+        return instance;
+    }
+    static std::map<uint16_t, std::string> & wireIdNames() {
+        static std::map<uint16_t, std::string> instance;
+        return instance;
+    }
+    static std::vector<BasicMsg * (*)()> & factoryRegistry() {
+        static std::vector<BasicMsg * (*)()> instance;
         return instance;
     }
 
@@ -94,8 +233,24 @@ private:
 #define MESSAGE_SUBCLASS(name) \
 virtual name * clone() const { return new name(*this); } \
 virtual std::string getName() const { return className(); } \
-virtual void pack(msgpack::packer<std::ostream> & pk) { pk.pack(className()); pk.pack(*this); } \
-static std::string className() { return std::string(#name); }
+virtual unsigned int getTypeIndex() const { return typeIndex(); } \
+virtual uint16_t getWireId() const { return wireId(); } \
+virtual void packBody(msgpack::packer<std::ostream> & pk) { pk.pack(*this); } \
+virtual void packBody(msgpack::packer<msgpack::sbuffer> & pk) { pk.pack(*this); } \
+virtual std::size_t packedSize() const { \
+    PackedSizeCounter c; msgpack::packer<PackedSizeCounter> pk(&c); \
+    pk.pack(wireId()); pk.pack(*this); return c.getSize(); } \
+static std::string className() { return std::string(#name); } \
+static constexpr uint16_t wireId() { return BasicMsg::wireIdOf(#name); } \
+static unsigned int typeIndex() { static const unsigned int index = BasicMsg::newTypeIndex(); return index; } \
+static void * operator new(std::size_t size) { \
+    return size == sizeof(name) ? MessagePool::allocate<sizeof(name)>() : ::operator new(size); } \
+static void * operator new(std::size_t size, void * p) { return p; } \
+static void operator delete(void * p, std::size_t size) { \
+    if (size == sizeof(name)) MessagePool::release<sizeof(name)>(p); else ::operator delete(p); } \
+static void operator delete(void * p, void * place) {} \
+template<class... Args> static std::shared_ptr<name> create(Args &&... args) { \
+    return std::allocate_shared<name>(MessagePool::Allocator<name>(), std::forward<Args>(args)...); }
 
 #define EMPTY_MSGPACK_DEFINE() \
 template <typename Packer> void msgpack_pack(Packer& pk) const {} \
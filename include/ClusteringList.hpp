@@ -21,9 +21,19 @@
 #ifndef CLUSTERINGLIST_HPP_
 #define CLUSTERINGLIST_HPP_
 
-#include <list>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <cmath>
 #include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <msgpack.hpp>
 #include "Logger.hpp"
+#include "util/PackedHash.hpp"
+#include "util/WorkerPool.hpp"
 
 namespace stars {
 
@@ -35,13 +45,340 @@ namespace stars {
  *     <li>A value field with the number of samples in the cluster</li>
  *     <li>A method distance that returns the distance to another cluster and precalculates the aggregation</li>
  *     <li>A method far that returns a fast distance calculation</li>
+ *     <li>A static constant numCoordinates and a method getCoordinates that projects the cluster
+ *         to the grid used by far, so that two clusters are far iff any of their coordinates differ</li>
  *     <li>A method aggregate that aggregates another cluster into it</li>
  *     <li>A method to output a representation of such object</li>
  *     <li>Serializable interface</li>
  * </ul>
+ *
+ * Clusters are stored contiguously. The clustering algorithm joins clusters by marking the
+ * absorbed ones with a value of zero, as tombstones, and compacts the list once per round.
+ * Before each round, the clusters are projected to their coordinates and grouped in buckets of
+ * clusters with the same coordinates, so that each cluster is only compared with the clusters
+ * of its own bucket instead of testing far against every other cluster. Clusters in different
+ * buckets are far by definition, so the result is the same.
+ *
+ * The lists of nearest clusters can be filled by several threads of the WorkerPool, see setNumThreads.
+ * Each list then gets its own partition of the pool of sums, so the result is the same as with one thread.
+ *
+ * The clusters are kept in chunks shared between copies of the list, so that copying a list and
+ * appending another one to it do not copy any cluster. Reading never copies; the first access
+ * that can modify the clusters, through a non-const method, copies them into a single chunk
+ * owned only by this list. Pointers obtained through the const methods stay valid until then,
+ * and positionOf translates them into positions that survive the copy.
  */
-template<class T> class ClusteringList : public std::list<T> {
+template<class T> class ClusteringList {
+    typedef std::shared_ptr<std::vector<T> > ChunkPtr;
+
 public:
+    typedef T value_type;
+    typedef T * iterator;
+
+    /// Iterator over the clusters of every chunk, in order
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T * pointer;
+        typedef const T & reference;
+
+        const_iterator() : chunk(NULL), lastChunk(NULL), pos(NULL), chunkEnd(NULL) {}
+
+        reference operator*() const {
+            return *pos;
+        }
+
+        pointer operator->() const {
+            return pos;
+        }
+
+        const_iterator & operator++() {
+            ++pos;
+            settle();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result(*this);
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator & r) const {
+            return pos == r.pos;
+        }
+
+        bool operator!=(const const_iterator & r) const {
+            return pos != r.pos;
+        }
+
+    private:
+        friend class ClusteringList;
+
+        const_iterator(const ChunkPtr * first, const ChunkPtr * last) : chunk(first), lastChunk(last),
+                pos(first != last ? (*first)->data() : NULL), chunkEnd(first != last ? pos + (*first)->size() : NULL) {
+            settle();
+        }
+
+        /// Moves to the next chunk at the end of the current one, skipping the empty ones
+        void settle() {
+            while (pos == chunkEnd && pos != NULL) {
+                if (++chunk == lastChunk) {
+                    pos = chunkEnd = NULL;
+                } else {
+                    pos = (*chunk)->data();
+                    chunkEnd = pos + (*chunk)->size();
+                }
+            }
+        }
+
+        const ChunkPtr * chunk, * lastChunk;
+        const T * pos, * chunkEnd;
+    };
+
+    ClusteringList() {}
+
+    std::size_t size() const {
+        std::size_t result = 0;
+        for (auto & c : chunks)
+            result += c->size();
+        return result;
+    }
+
+    bool empty() const {
+        for (auto & c : chunks)
+            if (!c->empty()) return false;
+        return true;
+    }
+
+    const_iterator begin() const {
+        return const_iterator(chunks.data(), chunks.data() + chunks.size());
+    }
+
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    /// Returns an iterator to the first cluster, which is not shared after this call
+    iterator begin() {
+        return detach().data();
+    }
+
+    /// Returns an iterator past the last cluster, which is not shared after this call
+    iterator end() {
+        std::vector<T> & v = detach();
+        return v.data() + v.size();
+    }
+
+    const T & operator[](std::size_t i) const {
+        assert(i < size());
+        auto c = chunks.begin();
+        while (i >= (*c)->size())
+            i -= (*c++)->size();
+        return (**c)[i];
+    }
+
+    T & operator[](std::size_t i) {
+        return detach()[i];
+    }
+
+    const T & front() const {
+        return *begin();
+    }
+
+    T & front() {
+        return detach().front();
+    }
+
+    void push_back(const T & c) {
+        detach().push_back(c);
+    }
+
+    void clear() {
+        chunks.clear();
+    }
+
+    /// Replaces the clusters of this list
+    void assign(std::vector<T> && v) {
+        chunks.assign(1, std::make_shared<std::vector<T> >(std::move(v)));
+    }
+
+    /// Appends the clusters of another list, sharing them
+    void append(const ClusteringList & o) {
+        for (auto & c : o.chunks)
+            if (!c->empty()) chunks.push_back(c);
+    }
+
+    /// Appends a set of clusters, without copying them
+    void append(std::vector<T> && v) {
+        if (!v.empty()) chunks.push_back(std::make_shared<std::vector<T> >(std::move(v)));
+    }
+
+    /**
+     * Obtains the position of a cluster from its address. The cluster must be one of this list,
+     * or of a copy that shares its chunk, obtained through a const method.
+     *
+     * The clusters may be shared until the list is modified, and the first modification moves
+     * them, so methods that modify the clusters found through the const methods must translate
+     * all of them into positions before they modify the first one.
+     */
+    std::size_t positionOf(const T * c) const {
+        std::size_t result = 0;
+        for (auto & chunk : chunks) {
+            if (c >= chunk->data() && c < chunk->data() + chunk->size())
+                return result + (c - chunk->data());
+            result += chunk->size();
+        }
+        assert(false && "the cluster is not in this list");
+        return result;
+    }
+
+    /**
+     * Makes the clusters modifiable, copying them into a single chunk if they are shared or split.
+     * Pointers to the clusters are not valid afterwards, see positionOf.
+     * @return The vector with all the clusters of this list.
+     */
+    std::vector<T> & detach() {
+        if (chunks.size() != 1 || chunks[0].use_count() > 1) {
+            std::shared_ptr<std::vector<T> > flat = std::make_shared<std::vector<T> >();
+            flat->reserve(size());
+            for (auto & c : chunks)
+                flat->insert(flat->end(), c->begin(), c->end());
+            chunks.assign(1, flat);
+        }
+        return *chunks[0];
+    }
+
+    bool operator==(const ClusteringList & r) const {
+        return size() == r.size() && std::equal(begin(), end(), r.begin());
+    }
+
+    /**
+     * \brief Clustering of a previous version of a list, to cluster the next ones incrementally.
+     *
+     * It remembers the chunks of the list that was clustered, the result, and which clusters of
+     * the list were aggregated into each cluster of the result. See reuse.
+     */
+    class Clustering {
+    public:
+        Clustering() : steps(0) {}
+
+        /// Forgets the previous clustering, so that the next list is clustered from scratch
+        void clear() {
+            source.clear();
+            result.reset();
+            groups.clear();
+            steps = 0;
+        }
+
+        /// Returns the number of incremental clusterings since the list was clustered from scratch
+        unsigned int getSteps() const {
+            return steps;
+        }
+
+    private:
+        friend class ClusteringList;
+
+        /// Clusters of the source list aggregated into a cluster of the result
+        struct Group {
+            std::vector<std::size_t> members;   ///< Positions in the source list
+            bool changed;                       ///< Whether it is not a cluster of the previous result
+        };
+
+        std::vector<ChunkPtr> source;   ///< Chunks of the list that was clustered
+        ChunkPtr result;                ///< Clusters of the result
+        std::vector<Group> groups;      ///< Group of each cluster of the result
+        unsigned int steps;             ///< Incremental clusterings since the last one from scratch
+    };
+
+    /**
+     * Prepares this list to be clustered incrementally. The clusters of the previous result whose
+     * group is still in this list, either in a shared chunk or as an equal cluster, replace
+     * the clusters of their group, so that only the rest of the clusters are aggregated again.
+     * Without a previous result the list is left as is, to be clustered from scratch.
+     * @param previous The clustering of a previous version of this list, which is updated.
+     */
+    void reuse(Clustering & previous) {
+        std::vector<const T *> current;
+        std::vector<std::size_t> newPosition;
+        if (previous.result.get()) {
+            const ClusteringList & self = *this;
+            current.reserve(size());
+            for (auto & c : self)
+                current.push_back(&c);
+            // Old clusters in chunks that are still in the list keep their position inside the chunk
+            std::vector<bool> usedChunk(chunks.size(), false), found(current.size(), false);
+            std::vector<const T *> old;
+            for (auto & chunk : previous.source) {
+                std::size_t offset = 0, k = 0;
+                while (k < chunks.size() && (usedChunk[k] || chunks[k] != chunk))
+                    offset += chunks[k++]->size();
+                for (std::size_t i = 0; i < chunk->size(); ++i) {
+                    old.push_back(&(*chunk)[i]);
+                    newPosition.push_back(k < chunks.size() ? offset + i : noPosition);
+                    if (k < chunks.size())
+                        found[offset + i] = true;
+                }
+                if (k < chunks.size())
+                    usedChunk[k] = true;
+            }
+            // The rest are looked for among the new clusters, by the hash of their packing
+            if (std::find(newPosition.begin(), newPosition.end(), noPosition) != newPosition.end()) {
+                std::unordered_multimap<uint64_t, std::size_t> index;
+                for (std::size_t j = 0; j < current.size(); ++j)
+                    if (!found[j])
+                        index.insert(std::make_pair(PackedHash::of(*current[j]), j));
+                for (std::size_t i = 0; i < old.size(); ++i) {
+                    if (newPosition[i] == noPosition) {
+                        auto candidates = index.equal_range(PackedHash::of(*old[i]));
+                        auto j = candidates.first;
+                        while (j != candidates.second && !(*current[j->second] == *old[i])) ++j;
+                        if (j != candidates.second) {
+                            newPosition[i] = j->second;
+                            index.erase(j);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<T> working;
+        std::vector<typename Clustering::Group> groups;
+        std::vector<bool> grouped(current.size(), false);
+        for (std::size_t r = 0; r < previous.groups.size(); ++r) {
+            typename Clustering::Group g = { previous.groups[r].members, false };
+            bool keep = true;
+            for (auto & m : g.members)
+                keep = keep && (m = newPosition[m]) != noPosition;
+            if (keep) {
+                for (auto m : g.members)
+                    grouped[m] = true;
+                working.push_back((*previous.result)[r]);
+                groups.push_back(std::move(g));
+            }
+        }
+        if (previous.result.get()) {
+            for (std::size_t j = 0; j < current.size(); ++j) {
+                if (!grouped[j]) {
+                    working.push_back(*current[j]);
+                    groups.push_back(typename Clustering::Group{ std::vector<std::size_t>(1, j), true });
+                }
+            }
+            ++previous.steps;
+        } else {
+            // From scratch, every cluster is its own group
+            for (std::size_t j = 0; j < size(); ++j)
+                groups.push_back(typename Clustering::Group{ std::vector<std::size_t>(1, j), true });
+            previous.steps = 0;
+        }
+        previous.source = chunks;
+        previous.groups = std::move(groups);
+        if (previous.result.get())
+            assign(std::move(working));
+    }
+
     /// Data structures for the aggregation algorithm
     struct DistanceList {
         struct DistanceTo {
@@ -126,30 +463,33 @@ public:
 
     class VectorOfDistances {
     public:
-        VectorOfDistances(ClusteringList & s) : source(s), useFarClusters(false) {}
+        VectorOfDistances(std::vector<T> & s) : source(s), useFarClusters(false), threads(numThreads) {}
 
         size_t populate() {
             size_t size = source.size();
             if (!heap.get()) {
                 heap.reset(new DistanceList *[size]);
-                sumPool.reset(new T[size * K + 1]);
+                // With several threads, every list has its own K + 1 sums
+                sumPool.reset(new T[threads > 1 ? size * (K + 1) : size * K + 1]);
                 lists.reset(new DistanceList[size]);
             } else {
                 for (DistanceList * dlsi = lists.get(); dlsi < lists.get() + size; ++dlsi) {
                     dlsi->reset();
                 }
             }
-            T * top = sumPool.get(), * free = top;
-            auto i = source.begin();
+            bool useCoordinates = projection && !useFarClusters;
+            if (useCoordinates)
+                buildBuckets();
+            if (threads > 1 && size > threads) {
+                std::atomic<size_t> next(0);
+                WorkerPool::getInstance().run(threads, [&]() { fillLists(next, useCoordinates); });
+            } else {
+                T * top = sumPool.get(), * free = top;
+                for (size_t i = 0; i < size; ++i)
+                    fillList(i, useCoordinates, free, top);
+            }
             DistanceList ** distancesi = heap.get();
             for (DistanceList * dlsi = lists.get(); dlsi < lists.get() + size; ++dlsi) {
-                dlsi->src = &(*i++);
-                // Calculate distance with K nearest
-                for (auto j = i; j != source.end(); ++j) {
-                    if (useFarClusters || !dlsi->src->far(*j)) {
-                        dlsi->add(dlsi->src->distance(*j, *free), &(*j), free, top);
-                    }
-                }
                 if (!dlsi->empty()) {
                     *(distancesi++) = dlsi;
                 }
@@ -165,11 +505,102 @@ public:
         }
 
     private:
-        ClusteringList & source;
+        std::vector<T> & source;
         bool useFarClusters;
         std::unique_ptr<DistanceList[]> lists;
         std::unique_ptr<DistanceList *[]> heap;
         std::unique_ptr<T[]> sumPool;
+        std::vector<double> coordinates;   ///< Coordinates of the clusters, one array per coordinate
+        std::vector<size_t> order;         ///< Indices of the clusters, sorted by bucket and index
+        std::vector<size_t> bucketEnd;     ///< End of the bucket of each position of order
+        std::vector<size_t> position;      ///< Position of each cluster in order
+        unsigned int threads;              ///< Number of threads that fill the lists
+
+        /// Calculates the K nearest clusters to the ith one, taking the sums from free and top
+        void fillList(size_t i, bool useCoordinates, T * & free, T * & top) {
+            size_t size = source.size();
+            DistanceList * dlsi = &lists[i];
+            dlsi->src = &source[i];
+            if (useCoordinates) {
+                // Only the rest of the bucket, in index order
+                if (position[i] != noPosition) {
+                    for (size_t p = position[i] + 1; p < bucketEnd[position[i]]; ++p) {
+                        size_t j = order[p];
+                        dlsi->add(dlsi->src->distance(source[j], *free), &source[j], free, top);
+                    }
+                }
+            } else {
+                for (size_t j = i + 1; j < size; ++j) {
+                    if (useFarClusters || !dlsi->src->far(source[j])) {
+                        dlsi->add(dlsi->src->distance(source[j], *free), &source[j], free, top);
+                    }
+                }
+            }
+        }
+
+        /// Fills the lists whose index is taken from a shared counter, each one with its partition of the pool
+        void fillLists(std::atomic<size_t> & next, bool useCoordinates) {
+            size_t size = source.size();
+            for (size_t i = next++; i < size; i = next++) {
+                T * top = sumPool.get() + i * (K + 1), * free = top;
+                fillList(i, useCoordinates, free, top);
+            }
+        }
+
+        /// Projects every cluster to its coordinates
+        void project() {
+            size_t size = source.size();
+            coordinates.resize(T::numCoordinates * size);
+            double c[T::numCoordinates];
+            for (size_t i = 0; i < size; ++i) {
+                source[i].getCoordinates(c);
+                for (unsigned int k = 0; k < T::numCoordinates; ++k)
+                    coordinates[k * size + i] = c[k];
+            }
+        }
+
+        /// Lexicographic order of the coordinates, and then by index
+        bool beforeInBucket(size_t i, size_t j) const {
+            size_t size = source.size();
+            for (const double * c = coordinates.data(); c < coordinates.data() + T::numCoordinates * size; c += size)
+                if (c[i] != c[j])
+                    return c[i] < c[j];
+            return i < j;
+        }
+
+        /// Whether two clusters have the same coordinates
+        bool sameCell(size_t i, size_t j) const {
+            size_t size = source.size();
+            for (const double * c = coordinates.data(); c < coordinates.data() + T::numCoordinates * size; c += size)
+                if (c[i] != c[j])
+                    return false;
+            return true;
+        }
+
+        /// Groups the clusters in buckets of clusters with the same coordinates
+        void buildBuckets() {
+            project();
+            size_t size = source.size();
+            order.clear();
+            position.assign(size, noPosition);
+            for (size_t i = 0; i < size; ++i) {
+                // A NaN coordinate makes a cluster far from every other one
+                bool valid = true;
+                for (unsigned int k = 0; k < T::numCoordinates && valid; ++k)
+                    valid = !std::isnan(coordinates[k * size + i]);
+                if (valid)
+                    order.push_back(i);
+            }
+            std::sort(order.begin(), order.end(), [this](size_t i, size_t j) { return beforeInBucket(i, j); });
+            bucketEnd.resize(order.size());
+            for (size_t start = 0, end; start < order.size(); start = end) {
+                for (end = start + 1; end < order.size() && sameCell(order[start], order[end]); ++end);
+                for (size_t p = start; p < end; ++p) {
+                    bucketEnd[p] = end;
+                    position[order[p]] = p;
+                }
+            }
+        }
 
         void checkNumAdditions() {
             if (!useFarClusters) {
@@ -189,24 +620,85 @@ public:
         K = k;
     }
 
+    /// Sets whether the candidates are searched in buckets of the projected coordinates, or with far
+    static void setProjection(bool p) {
+        projection = p;
+    }
+
+    /// Sets the number of threads that calculate the distances between clusters; one means no additional thread
+    static void setNumThreads(unsigned int n) {
+        numThreads = n;
+    }
+
     void purge() {
-        // Remove clusters with value equal to zero
-        for (auto i = this->begin(); i != this->end();) {
-            if (i->value == 0) {
-                i = this->erase(i);
-            } else {
-                ++i;
-            }
-        }
+        // Remove clusters with value equal to zero, keeping the order of the rest
+        std::vector<T> & v = detach();
+        v.erase(std::remove_if(v.begin(), v.end(), [](const T & c) { return c.value == 0; }), v.end());
+    }
+
+    /**
+     * Merges a sorted range of clusters into this one, also sorted, like std::list::merge.
+     * @param other The container with the other clusters, which is left empty.
+     */
+    template<class C> void merge(C & other) {
+        std::vector<T> result;
+        result.reserve(size() + other.size());
+        std::merge(std::make_move_iterator(begin()), std::make_move_iterator(end()), std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()),
+                std::back_inserter(result));
+        assign(std::move(result));
+        other.clear();
     }
 
     void cluster(size_t limit) {
-        VectorOfDistances vod(*this);
-        while (this->size() > limit) {
+        cluster(limit, NULL);
+    }
+
+    /**
+     * Clusters the list prepared by reuse, and keeps the result for the next version.
+     * @param limit Maximum number of clusters.
+     * @param previous The clustering passed to reuse.
+     * @param finish Function applied to the clusters of the result that are not in the previous one.
+     */
+    template<class F> void cluster(size_t limit, Clustering & previous, F finish) {
+        cluster(limit, &previous.groups);
+        std::vector<T> & v = *chunks[0];
+        for (std::size_t i = 0; i < v.size(); ++i)
+            if (previous.groups[i].changed)
+                finish(v[i]);
+        previous.result = chunks[0];
+    }
+
+    friend std::ostream & operator<<(std::ostream & os, const ClusteringList & o) {
+        for (auto & i : o)
+            os << '(' << i << ')';
+        return os;
+    }
+
+    // Packed as an array with the vector of clusters, as when this list was a vector
+    template <typename Packer> void msgpack_pack(Packer & pk) const {
+        pk.pack_array(1);
+        pk.pack_array(size());
+        for (auto & c : *this)
+            pk.pack(c);
+    }
+
+    void msgpack_unpack(msgpack::object o) {
+        if (o.type != msgpack::type::ARRAY || o.via.array.size < 1) { throw msgpack::type_error(); }
+        std::vector<T> v;
+        o.via.array.ptr[0].convert(&v);
+        assign(std::move(v));
+    }
+
+private:
+    /// Clusters the list, aggregating the groups of the clusters too if there are any
+    void cluster(size_t limit, std::vector<typename Clustering::Group> * groups) {
+        std::vector<T> & v = detach();
+        VectorOfDistances vod(v);
+        while (v.size() > limit) {
             size_t heapSize = vod.populate();
             DistanceList ** distanceHeap = vod.getHeapPointer();
 
-            unsigned int numClusters = this->size() - limit, clustersJoined = 0;
+            unsigned int numClusters = v.size() - limit, clustersJoined = 0;
             while (heapSize > 0 && clustersJoined < numClusters &&
                     distanceHeap[0]->dst->d != std::numeric_limits<double>::infinity()) {
                 std::pop_heap(distanceHeap, distanceHeap + heapSize, compDL);
@@ -228,6 +720,12 @@ public:
                         *best.src = std::move(*best.dst->sum);
                         best.dst->invalidate();
                         clustersJoined++;
+                        if (groups) {
+                            typename Clustering::Group & g = (*groups)[best.src - v.data()];
+                            std::vector<std::size_t> & absorbed = (*groups)[best.dst->to - v.data()].members;
+                            g.members.insert(g.members.end(), absorbed.begin(), absorbed.end());
+                            g.changed = true;
+                        }
                     }
                     best.advance();
                     if (!best.empty()) {
@@ -241,24 +739,33 @@ public:
                 }
             }
             if (clustersJoined == 0) break;
+            if (groups) {
+                // Same compaction as purge
+                std::size_t j = 0;
+                for (std::size_t i = 0; i < v.size(); ++i)
+                    if (v[i].value != 0 && j++ != i)
+                        (*groups)[j - 1] = std::move((*groups)[i]);
+                groups->resize(j);
+            }
             purge();
         }
     }
 
-    friend std::ostream & operator<<(std::ostream & os, const ClusteringList & o) {
-        for (auto & i : o)
-            os << '(' << i << ')';
-        return os;
-    }
-
-    MSGPACK_DEFINE((std::list<T> &)*this);
+    std::vector<ChunkPtr> chunks;   ///< Clusters of the list, in order, possibly shared with other lists
 
-private:
     /// Maximum size of the vector of samples
     static unsigned int K;
+    static const size_t noPosition = std::numeric_limits<size_t>::max();
+    /// Whether the candidates are searched in buckets of the projected coordinates
+    static bool projection;
+    /// Number of threads used by the clustering algorithm
+    static unsigned int numThreads;
 };
 
 template<class T> unsigned int ClusteringList<T>::K = 10;
+template<class T> bool ClusteringList<T>::projection = true;
+template<class T> unsigned int ClusteringList<T>::numThreads = 1;
+template<class T> const size_t ClusteringList<T>::noPosition;
 
 } // namespace stars
 
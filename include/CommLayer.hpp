@@ -22,14 +22,20 @@
 #define COMMLAYER_H_
 
 #include <vector>
+#include <string>
+#include <memory>
 #include <queue>
 #include <utility>
-#include <boost/thread/condition.hpp>
+#include <atomic>
+#include <boost/thread/mutex.hpp>
 
 #include "CommAddress.hpp"
 #include "BasicMsg.hpp"
 #include "Time.hpp"
 #include "NetworkManager.hpp"
+#include "TimerQueue.hpp"
+#include "CommStatistics.hpp"
+#include "util/MPSCQueue.hpp"
 
 
 class CommLayer;
@@ -38,19 +44,114 @@ class CommLayer;
  * \brief A service for message handling.
  *
  * This interface must be implemented by any component which wishes to handle
- * a certain kind of message. After registering with the CommLayer, it will
- * receive all the messages, so that it can select which ones to handle.
+ * a certain kind of message. A service declares the message types it handles with a
+ * HandlerTable, and after registering with the CommLayer it only receives those types.
+ * A service without a HandlerTable receives all the messages, so that it can select
+ * which ones to handle.
  */
 class Service {
 public:
+    /**
+     * Handler of a certain message type in a certain Service subclass.
+     */
+    typedef void (*Handler)(Service & s, const CommAddress & src, const BasicMsg & msg);
+
+    /**
+     * \brief Table of message handlers of a Service subclass.
+     *
+     * It is built once per subclass, usually as a static object, with the handlers of
+     * each message type.
+     */
+    class HandlerTable {
+    public:
+        /// Adds the handler of a message class.
+        template<class Message> HandlerTable & add(Handler h) {
+            entries.push_back(Entry(Message::typeIndex(), NULL, h));
+            return *this;
+        }
+
+        /// Adds the handler of a message class and all its registered subclasses.
+        template<class Message> HandlerTable & addFamily(Handler h) {
+            entries.push_back(Entry(Message::typeIndex(), &isA<Message>, h));
+            return *this;
+        }
+
+        /**
+         * Looks for the handler of a message.
+         * @param msg The message.
+         * @return The handler, or NULL if there is none.
+         */
+        Handler find(const BasicMsg & msg) const;
+
+        /// Returns whether there is any handler for a whole family of messages
+        bool hasFamilies() const;
+
+        /// Returns the number of handlers
+        unsigned int size() const {
+            return entries.size();
+        }
+
+        /// Returns the type index of the i-th handler
+        unsigned int getType(unsigned int i) const {
+            return entries[i].type;
+        }
+
+        /// Returns the i-th handler
+        Handler getHandler(unsigned int i) const {
+            return entries[i].handler;
+        }
+
+    private:
+        template<class Message> static bool isA(const BasicMsg & msg) {
+            return dynamic_cast<const Message *>(&msg) != NULL;
+        }
+
+        struct Entry {
+            unsigned int type;                     ///< Type index of the message class
+            bool (*matches)(const BasicMsg &);     ///< Subclass check, NULL for just one class
+            Handler handler;                       ///< The handler
+            Entry(unsigned int t, bool (*m)(const BasicMsg &), Handler h) : type(t), matches(m), handler(h) {}
+        };
+
+        std::vector<Entry> entries;
+    };
+
     virtual ~Service() {}
 
+    /**
+     * Handles a message, if this service knows how.
+     * @param src Source address.
+     * @param msg The message.
+     * @return True if the message was handled.
+     */
+    virtual bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
+        const HandlerTable * table = getHandlers();
+        Handler h = table ? table->find(msg) : NULL;
+        if (h) h(*this, src, msg);
+        return h != NULL;
+    }
+
 protected:
     friend class CommLayer;
-    virtual bool receiveMessage(const CommAddress & src, const BasicMsg & msg) = 0;
+
+    /**
+     * Returns the handlers of this service, or NULL if it wants to receive every message.
+     * The table must remain the same during the lifetime of the service.
+     */
+    virtual const HandlerTable * getHandlers() const {
+        return NULL;
+    }
 };
 
 
+/**
+ * Builds a Handler that calls the handle method of a service class for a message class.
+ * It must be used inside a member function of the service class, to access its handle methods.
+ */
+#define SERVICE_HANDLER(service, message) \
+    [](Service & s, const CommAddress & src, const BasicMsg & msg) { static_cast<service &>(s).handle(src, static_cast<const message &>(msg)); }
+
+
 /**
  * \brief Communications layer.
  *
@@ -82,6 +183,7 @@ public:
      */
     void registerService(Service * c) {
         services.push_back(c);
+        updateRoutes();
     }
 
     /**
@@ -93,6 +195,7 @@ public:
             if (*i == c) {
                 delete c;
                 services.erase(i);
+                updateRoutes();
                 break;
             }
     }
@@ -105,6 +208,14 @@ public:
         nm->listen();
     }
 
+    /**
+     * Stops the threads that handle network events, so that only the calling thread is left
+     * running in the CommLayer.
+     */
+    void stopNetwork() {
+        nm->stop();
+    }
+
     /**
      * Takes the next message from the queue and relays it to the services.
      */
@@ -121,7 +232,7 @@ public:
     void stopEventLoop();
 
     /**
-     * Checks whether the queue is empty
+     * Checks whether the queue is empty. Only accurate from the thread that runs the event loop.
      * @return True when there are messages in the queue.
      */
     bool availableMessages() const {
@@ -138,6 +249,16 @@ public:
      */
     unsigned int sendMessage(const CommAddress & dst, BasicMsg * msg);
 
+    /**
+     * Checks whether the messages to a node are piling up because it does not keep up with them.
+     * Messages that can be superseded by later ones should not be sent meanwhile.
+     * @param dst Destination address.
+     * @return True if the send queue to that node is over its limit. Always false without a network.
+     */
+    bool isCongested(const CommAddress & dst) const {
+        return nm.get() && nm->isCongested(dst);
+    }
+
     unsigned int sendLocalMessage(BasicMsg * msg) {
         return sendMessage(localAddress, msg);
     }
@@ -180,6 +301,27 @@ public:
      */
     void cancelTimer(int timerId);
 
+    /**
+     * Starts measuring how long each message waits in the queue and how long its handlers take.
+     * Snapshots are cumulative since this call. It must be called from the thread that runs the event loop.
+     * @param file File where a snapshot is written periodically, none if empty.
+     * @param period Time between snapshots.
+     */
+    void enableStatistics(const std::string & file = std::string(), Duration period = Duration(60.0));
+
+    /**
+     * Stops measuring message handling, writing a last snapshot if there is a statistics file.
+     * It must be called from the thread that runs the event loop, but not from a message handler.
+     */
+    void disableStatistics();
+
+    /**
+     * Returns the message handling statistics, or NULL if they are disabled.
+     */
+    const CommStatistics * getStatistics() const {
+        return stats.get();
+    }
+
 protected:
     friend class NetworkManager;
 
@@ -194,6 +336,22 @@ protected:
      */
     void enqueueMessage(const CommAddress & src, const std::shared_ptr<BasicMsg> & msg);
 
+    /**
+     * Relays a message to the registered services.
+     * @param src Source address.
+     * @param msg Message that is being handled.
+     */
+    void handleMessage(const CommAddress & src, const std::shared_ptr<BasicMsg> & msg);
+
+    /// Writes a snapshot of the statistics if the period has elapsed
+    void checkStatisticsSnapshot();
+
+    /**
+     * Rebuilds the routes of message types to services. It must be called whenever
+     * the list of services changes.
+     */
+    void updateRoutes();
+
     /// Adds a new timer without checking if time is greater than current time
     int setTimerImpl(Time time, std::shared_ptr<BasicMsg> msg);
 
@@ -204,38 +362,32 @@ protected:
 
     std::unique_ptr<NetworkManager> nm;
 
-    typedef std::pair<CommAddress, std::shared_ptr<BasicMsg> > AddrMsg;
+    /// A message in the queue, stamped with its arrival time when statistics are enabled
+    struct QueuedMsg {
+        CommAddress src;                  ///< Source address
+        std::shared_ptr<BasicMsg> msg;    ///< The message
+        uint64_t arrival;                 ///< Arrival timestamp, or 0 if it was not measured
+        QueuedMsg() : arrival(0) {}
+        QueuedMsg(const CommAddress & s, const std::shared_ptr<BasicMsg> & m, uint64_t a) : src(s), msg(m), arrival(a) {}
+    };
+    /// Default capacity of the message queue
+    static const std::size_t defaultQueueCapacity = 4096;
     /// Registered services
     std::vector<Service *> services;
-    std::list<AddrMsg> messageQueue;    ///< Queue of received messages
-    boost::mutex queueMutex;            ///< Mutex to put and get queue messages.
-    boost::condition nonEmptyQueue;     ///< Barrier to wait for a message
-    bool exitSignaled;                  ///< True when a SIGINT arrives, to exit the event loop
-
-    /**
-     * A timer, which delivers a message at a specific time.
-     */
-    struct Timer {
-        static int timerId;   ///< ID counter
-
-        Time timeout;              ///< Time at which the message is to be delivered
-        std::shared_ptr<BasicMsg> msg;   ///< Message to be delivered
-        int id;                     ///< ID of this timer
-
-        /// Constructor, from a time and a message
-        Timer(Time t, std::shared_ptr<BasicMsg> m) : timeout(t), msg(m), id(++timerId) {}
-
-        /**
-        * Less operator.
-        * @param r Right operand.
-        * @return True if this timer is earlier than r.
-        */
-        bool operator<(const Timer & r) {
-            return timeout < r.timeout;
-        }
-    };
-
-    std::list<Timer> timerList;   ///< List of timers in timeout order
+    class RoutingTable;
+    /// Services that handle each message type, shared by every CommLayer with the same kind of services
+    std::shared_ptr<const RoutingTable> routes;
+    MPSCQueue<QueuedMsg> messageQueue;  ///< Queue of received messages
+    std::atomic<bool> exitSignaled;     ///< True when a SIGINT arrives, to exit the event loop
+
+    std::unique_ptr<CommStatistics> stats;   ///< Message handling statistics, NULL when disabled
+    std::atomic<bool> measuring;      ///< Whether arriving messages are stamped, read by the producers
+    std::string statsFile;            ///< File that receives the snapshots, none if empty
+    uint64_t statsPeriod;             ///< Nanoseconds between snapshots
+    uint64_t nextSnapshot;            ///< Timestamp of the next snapshot
+
+    typedef TimerQueue::Timer Timer;
+    TimerQueue timers;            ///< Pending timers in timeout order
     boost::mutex timerMutex;      ///< Object access mutex
 
     CommAddress localAddress;   ///< Local address of this node
@@ -0,0 +1,208 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMSTATISTICS_H_
+#define COMMSTATISTICS_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <ostream>
+#include <cstdint>
+#include <chrono>
+#include "BasicMsg.hpp"
+
+
+class Service;
+
+
+/**
+ * \brief Log-linear histogram of latencies, in nanoseconds.
+ *
+ * Each power of two is divided in a fixed number of linear sub-buckets, so that the relative error
+ * of any value is bounded by the sub-bucket width while the whole 64-bit range fits in a few hundred
+ * counters. Recording a value is a handful of integer instructions.
+ */
+class LatencyHistogram {
+public:
+    static const unsigned int subBucketBits = 3;   ///< Log2 of the number of sub-buckets per power of two
+    static const unsigned int subBuckets = 1 << subBucketBits;
+    static const unsigned int numBuckets = (64 - subBucketBits + 1) << subBucketBits;
+
+    LatencyHistogram() {
+        clear();
+    }
+
+    /// Adds a value
+    void record(uint64_t ns) {
+        ++buckets[bucketOf(ns)];
+        ++count;
+        sum += ns;
+        if (ns > max) max = ns;
+    }
+
+    /// Removes all the values
+    void clear();
+
+    /// Returns the number of values
+    uint64_t getCount() const {
+        return count;
+    }
+
+    /// Returns the sum of all the values
+    uint64_t getSum() const {
+        return sum;
+    }
+
+    /// Returns the maximum value
+    uint64_t getMax() const {
+        return max;
+    }
+
+    /// Returns the number of values in a bucket
+    uint64_t getBucketCount(unsigned int b) const {
+        return buckets[b];
+    }
+
+    /**
+     * Returns an upper bound of a percentile, at most one sub-bucket above its real value.
+     * @param p The percentile, between 0 and 1.
+     */
+    uint64_t getPercentile(double p) const;
+
+    /// Returns the bucket of a value
+    static unsigned int bucketOf(uint64_t ns) {
+        if (ns < subBuckets) return ns;
+        unsigned int shift = 63 - __builtin_clzll(ns) - subBucketBits;
+        return ((shift + 1) << subBucketBits) + ((ns >> shift) & (subBuckets - 1));
+    }
+
+    /// Returns the smallest value of a bucket
+    static uint64_t lowerBound(unsigned int b) {
+        if (b < subBuckets) return b;
+        unsigned int shift = (b >> subBucketBits) - 1;
+        return (uint64_t)(subBuckets + (b & (subBuckets - 1))) << shift;
+    }
+
+    /// Returns the largest value of a bucket
+    static uint64_t upperBound(unsigned int b) {
+        return b + 1 < numBuckets ? lowerBound(b + 1) - 1 : UINT64_MAX;
+    }
+
+private:
+    uint64_t buckets[numBuckets];   ///< Number of values in each bucket
+    uint64_t count;                 ///< Number of values
+    uint64_t sum;                   ///< Sum of the values
+    uint64_t max;                   ///< Maximum value
+};
+
+
+/**
+ * \brief Message handling statistics of a CommLayer.
+ *
+ * Counts the messages handled by each message type and by each service, with histograms of the
+ * time each message waits in the queue and the time its handlers take. Only the thread that runs
+ * the event loop updates them, so no synchronization is needed. Services are identified by their
+ * position in the CommLayer, and their statistics follow them when the list changes.
+ */
+class CommStatistics {
+public:
+    /// Statistics of a message type
+    struct TypeStats {
+        std::string name;                ///< Name of the message class
+        LatencyHistogram queueDelay;     ///< Time from enqueueMessage to dispatch
+        LatencyHistogram handlerTime;    ///< Time spent in all the services
+        explicit TypeStats(const std::string & n) : name(n) {}
+    };
+
+    /// Statistics of a service
+    struct ServiceStats {
+        const Service * service;         ///< The service, or NULL if it was unregistered
+        std::string name;                ///< Name of the service class
+        LatencyHistogram handlerTime;    ///< Time spent handling each message
+        explicit ServiceStats(const Service * s);
+    };
+
+    /// Returns a monotonic timestamp in nanoseconds, only meaningful as a difference
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// Adds the queueing delay of a message
+    void addQueueDelay(const BasicMsg & msg, uint64_t ns) {
+        getType(msg).queueDelay.record(ns);
+    }
+
+    /// Adds the time a message took in all its handlers
+    void addHandlerTime(const BasicMsg & msg, uint64_t ns) {
+        getType(msg).handlerTime.record(ns);
+    }
+
+    /// Adds the time a message took in the service at a certain position
+    void addServiceTime(unsigned int service, uint64_t ns) {
+        serviceStats[current[service]]->handlerTime.record(ns);
+    }
+
+    /**
+     * Updates the position of each service. It must be called whenever the list of services changes.
+     * @param services The registered services, in order.
+     */
+    void setServices(const std::vector<Service *> & services);
+
+    /// Returns the statistics of a message type, or NULL if no message of that type was handled
+    const TypeStats * getTypeStats(unsigned int type) const {
+        return type < typeStats.size() ? typeStats[type].get() : NULL;
+    }
+
+    /// Returns the statistics of the service at a certain position
+    const ServiceStats & getServiceStats(unsigned int service) const {
+        return *serviceStats[current[service]];
+    }
+
+    /// Removes all the values, keeping the services
+    void clear();
+
+    /**
+     * Writes a snapshot of the statistics, one line per message type and per service,
+     * with times in microseconds.
+     */
+    void output(std::ostream & os) const;
+
+    /**
+     * Writes a snapshot to a file, replacing its contents.
+     * @return False if the file could not be written.
+     */
+    bool write(const std::string & file) const;
+
+private:
+    TypeStats & getType(const BasicMsg & msg) {
+        unsigned int type = msg.getTypeIndex();
+        if (type >= typeStats.size()) typeStats.resize(type + 1);
+        if (!typeStats[type].get()) typeStats[type].reset(new TypeStats(msg.getName()));
+        return *typeStats[type];
+    }
+
+    std::vector<std::unique_ptr<TypeStats> > typeStats;         ///< Statistics of each type, created on first use
+    std::vector<std::unique_ptr<ServiceStats> > serviceStats;   ///< Statistics of every service ever registered
+    std::vector<unsigned int> current;   ///< Position in serviceStats of each registered service
+};
+
+#endif /* COMMSTATISTICS_H_ */
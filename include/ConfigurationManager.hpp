@@ -42,6 +42,9 @@ class ConfigurationManager {
     uint16_t port;            ///< TCP port to listen to
     uint16_t uiPort;          ///< TCP port for UI connections
     std::string logString;    ///< Logging configuration string
+    std::string logFile;      ///< File written by the asynchronous log sink, none if empty
+    unsigned int logBuffer;   ///< Number of log records that each thread can have pending
+    bool logBlock;            ///< Whether to wait for room in a full log buffer instead of dropping records
     int submitRetries;        ///< Number of retries of a failing submission
     int heartbeat;   ///< Number of seconds between heartbeat signals from scheduler to submission nodes
     unsigned int availMemory;       ///< Available memory for tasks
@@ -50,6 +53,13 @@ class ConfigurationManager {
     std::string entryPoint;
     double requestTimeout;
     double rescheduleTimeout;
+    double linkIdleTimeout;         ///< Seconds before an unused connection to another node is closed
+    unsigned int sendQueueLimit;    ///< Bytes waiting to be sent to another node before its link is congested
+    unsigned int ioThreads;         ///< Number of threads that handle network events
+    std::string commStatsFile;      ///< File that receives the message handling statistics, none if empty
+    double commStatsPeriod;         ///< Seconds between snapshots of the message handling statistics
+    unsigned int incrementalReductions;  ///< Consecutive incremental reductions of the information before one from scratch
+    unsigned int deltaUpdates;      ///< Consecutive availability updates sent as changes before a whole one
 
     /// default constructor, prevents instantiation
     ConfigurationManager();
@@ -159,6 +169,48 @@ public:
         logString = s;
     }
 
+    /**
+     * Returns the file written by the asynchronous log sink, or an empty path to log synchronously.
+     */
+    const std::string & getLogFile() const {
+        return logFile;
+    }
+
+    /**
+     * Sets the file written by the asynchronous log sink.
+     */
+    void setLogFile(const std::string & f) {
+        logFile = f;
+    }
+
+    /**
+     * Returns the number of log records that each thread can have pending.
+     */
+    unsigned int getLogBuffer() const {
+        return logBuffer;
+    }
+
+    /**
+     * Sets the number of log records that each thread can have pending.
+     */
+    void setLogBuffer(unsigned int b) {
+        logBuffer = b;
+    }
+
+    /**
+     * Returns whether threads wait for room in a full log buffer, instead of dropping records.
+     */
+    bool getLogBlock() const {
+        return logBlock;
+    }
+
+    /**
+     * Sets whether threads wait for room in a full log buffer, instead of dropping records.
+     */
+    void setLogBlock(bool b) {
+        logBlock = b;
+    }
+
     /**
      * Returns the number of retries of a failed submission.
      */
@@ -246,6 +298,107 @@ public:
     void setRescheduleTimeout(double rt) {
         rescheduleTimeout = rt;
     }
+
+    /**
+     * Returns the number of seconds before an unused connection to another node is closed.
+     */
+    double getLinkIdleTimeout() const {
+        return linkIdleTimeout;
+    }
+
+    /**
+     * Sets the number of seconds before an unused connection to another node is closed.
+     */
+    void setLinkIdleTimeout(double t) {
+        linkIdleTimeout = t;
+    }
+
+    /**
+     * Returns the number of bytes waiting to be sent to another node beyond which its link is congested.
+     */
+    unsigned int getSendQueueLimit() const {
+        return sendQueueLimit;
+    }
+
+    /**
+     * Sets the number of bytes waiting to be sent to another node beyond which its link is congested.
+     */
+    void setSendQueueLimit(unsigned int l) {
+        sendQueueLimit = l;
+    }
+
+    /**
+     * Returns the number of threads that handle network events and unpack incoming messages.
+     */
+    unsigned int getIOThreads() const {
+        return ioThreads;
+    }
+
+    /**
+     * Sets the number of threads that handle network events and unpack incoming messages.
+     */
+    void setIOThreads(unsigned int n) {
+        ioThreads = n;
+    }
+
+    /**
+     * Returns the file that receives the message handling statistics, or an empty path to disable them.
+     */
+    const std::string & getCommStatsFile() const {
+        return commStatsFile;
+    }
+
+    /**
+     * Sets the file that receives the message handling statistics.
+     */
+    void setCommStatsFile(const std::string & f) {
+        commStatsFile = f;
+    }
+
+    /**
+     * Returns the number of seconds between snapshots of the message handling statistics.
+     */
+    double getCommStatsPeriod() const {
+        return commStatsPeriod;
+    }
+
+    /**
+     * Sets the number of seconds between snapshots of the message handling statistics.
+     */
+    void setCommStatsPeriod(double p) {
+        commStatsPeriod = p;
+    }
+
+    /**
+     * Returns the number of times the availability information can be reduced incrementally, only
+     * aggregating again the clusters that changed, before it is reduced from scratch; zero to always
+     * reduce it from scratch.
+     */
+    unsigned int getIncrementalReductions() const {
+        return incrementalReductions;
+    }
+
+    /**
+     * Sets the number of incremental reductions before the information is reduced from scratch.
+     */
+    void setIncrementalReductions(unsigned int n) {
+        incrementalReductions = n;
+    }
+
+    /**
+     * Returns the number of consecutive availability updates that can be sent as the changes from
+     * the previous one before the whole information is sent again, zero to always send it whole.
+     */
+    unsigned int getDeltaUpdates() const {
+        return deltaUpdates;
+    }
+
+    /**
+     * Sets the number of consecutive availability updates that can be sent as changes.
+     */
+    void setDeltaUpdates(unsigned int n) {
+        deltaUpdates = n;
+    }
 };
 
 #endif /* CONFIGURATIONMANAGER_H_ */
@@ -29,6 +29,9 @@
 #include "TaskDescription.hpp"
 #include "ClusteringList.hpp"
 #include "LDeltaFunction.hpp"
+#include "AvailabilityDelta.hpp"
+
+class DPAvailabilityDelta;
 
 
 /**
@@ -83,6 +86,11 @@ public:
 
         bool far(const MDFCluster & r) const;
 
+        static const unsigned int numCoordinates = 4;
+
+        /// Projects this cluster to the grid used by far
+        void getCoordinates(double * c) const;
+
         /// Aggregation operator for the clustering algorithm
         void aggregate(const MDFCluster & r);
 
@@ -110,17 +118,24 @@ public:
     };
 
     class AssignmentInfo {
-        AssignmentInfo(MDFCluster * c, uint32_t v, uint32_t m, uint32_t d, uint32_t t) :
+        AssignmentInfo(const MDFCluster * c, uint32_t v, uint32_t m, uint32_t d, uint32_t t) :
                 cluster(c), remngMem(m), remngDisk(d), remngAvail(t), numTasks(v) {}
         friend class DPAvailabilityInformation;
     public:
-        MDFCluster * cluster;
+        const MDFCluster * cluster;
         uint32_t remngMem, remngDisk, remngAvail;
         uint32_t numTasks;
     };
 
     MESSAGE_SUBCLASS(DPAvailabilityInformation);
 
+    /// Type of the clusters of the summary
+    typedef MDFCluster Cluster;
+    /// Type of the changes between two versions of this information
+    typedef DPAvailabilityDelta Delta;
+    /// Type of the clustering kept to reduce the next versions of this information
+    typedef stars::ClusteringList<MDFCluster>::Clustering Reduction;
+
     /// Default constructor, creates an empty information piece
     DPAvailabilityInformation() {
         reset();
@@ -157,6 +172,12 @@ public:
 
     void reduce();
 
+    /**
+     * Reduces the summary, aggregating again only the clusters that changed since a previous reduction.
+     * @param previous The previous reduction, which is updated with this one.
+     */
+    void reduce(Reduction & previous);
+
     // This is documented in AvailabilityInformation.h
     bool operator==(const DPAvailabilityInformation & r) const {
         return summary == r.summary;
@@ -183,6 +204,11 @@ public:
         return summary;
     }
 
+    /// Replaces the clusters of the summary
+    void setSummary(std::vector<MDFCluster> && s) {
+        summary.assign(std::move(s));
+    }
+
     MSGPACK_DEFINE((AvailabilityInformation &)*this, summary, minM, maxM, minD, maxD, minA, maxA, horizon);
 private:
     static unsigned int numClusters;
@@ -199,4 +225,16 @@ private:
     Time aggregationTime;     ///< Time at which aggregation is performed
 };
 
+
+/// Changes between two versions of a DPAvailabilityInformation
+class DPAvailabilityDelta : public SummaryDelta<DPAvailabilityInformation> {
+public:
+    MESSAGE_SUBCLASS(DPAvailabilityDelta);
+
+    DPAvailabilityDelta() {}
+
+    DPAvailabilityDelta(const DPAvailabilityInformation & base, const DPAvailabilityInformation & next)
+        : SummaryDelta<DPAvailabilityInformation>(base, next) {}
+};
+
 #endif /* DPAVAILABILITYINFORMATION_H_ */
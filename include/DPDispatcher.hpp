@@ -38,20 +38,14 @@ public:
      * Constructs a DeadlineDispatcher and associates it with the corresponding StructureNode.
      * @param sn The StructureNode of this branch.
      */
-    DPDispatcher(OverlayBranch & b) : Dispatcher(b) {}
+    DPDispatcher(OverlayBranch & b) : Dispatcher(b), recentRequests(REQUEST_CACHE_SIZE, REQUEST_CACHE_TIME) {}
 
 private:
     struct DecissionInfo;
-    struct RecentRequest {
-        CommAddress requester;
-        int64_t requestId;
-        Time when;
-        RecentRequest(const CommAddress & r, int64_t id, Time t) : requester(r), requestId(id), when(t) {}
-    };
 
     static const Duration REQUEST_CACHE_TIME;
     static const unsigned int REQUEST_CACHE_SIZE;
-    std::list<RecentRequest> recentRequests;
+    RecentRequestCache recentRequests;   ///< Requests routed recently, to detect retries
 
     /**
      * A Task bag allocation request. It is received when a client wants to assign a group
@@ -29,9 +29,40 @@
 #include "OverlayBranch.hpp"
 #include "TaskBagMsg.hpp"
 #include "UpdateTimer.hpp"
+#include "UpdateRequestMsg.hpp"
+#include "util/LRUCache.hpp"
+#include "util/PackedHash.hpp"
 class AvailabilityInformation;
 
 
+/**
+ * Identifies a request by its requester and request ID, to detect the duplicates of a request
+ * that arrive when it is retried.
+ */
+struct RequestKey {
+    CommAddress requester;
+    int64_t requestId;
+
+    RequestKey(const CommAddress & r, int64_t id) : requester(r), requestId(id) {}
+
+    bool operator==(const RequestKey & r) const {
+        return requestId == r.requestId && requester == r.requester;
+    }
+
+    /// Hash functor, for hashed containers
+    struct Hash {
+        std::size_t operator()(const RequestKey & k) const {
+            uint64_t addr = ((uint64_t)k.requester.getIPNum() << 16) | k.requester.getPort();
+            return std::hash<uint64_t>()(addr * 0x9E3779B97F4A7C15ULL ^ (uint64_t)k.requestId);
+        }
+    };
+};
+
+
+/// Cache of recently routed requests, shared by the dispatchers that drop duplicate requests
+typedef LRUCache<RequestKey, RequestKey::Hash> RecentRequestCache;
+
+
 class DispatcherInterface : public Service {
 public:
     virtual ~DispatcherInterface() {}
@@ -69,17 +100,14 @@ public:
     virtual ~Dispatcher() {}
 
     // This is documented in Service.
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-        if (dynamic_cast<const TaskBagMsg *>(&msg)) {
-            handle(src, static_cast<const TaskBagMsg &>(msg));
-            return true;
-        } else if (typeid(msg) == typeid(UpdateTimer)) {
-            handle(src, static_cast<const UpdateTimer &>(msg));
-            return true;
-        } else if (typeid(msg) == typeid(T)) {
-            handle(src, static_cast<const T &>(msg));
-            return true;
-        } else return false;
+    const HandlerTable * getHandlers() const {
+        static const HandlerTable handlers = HandlerTable()
+            .template addFamily<TaskBagMsg>(SERVICE_HANDLER(Dispatcher, TaskBagMsg))
+            .template add<UpdateTimer>(SERVICE_HANDLER(Dispatcher, UpdateTimer))
+            .template add<UpdateRequestMsg>(SERVICE_HANDLER(Dispatcher, UpdateRequestMsg))
+            .template add<T>(SERVICE_HANDLER(Dispatcher, T))
+            .template add<typename T::Delta>(SERVICE_HANDLER(Dispatcher, typename T::Delta));
+        return &handlers;
     }
 
     // This is documented in DispatcherInterface.
@@ -106,20 +134,43 @@ public:
         child[1].serializeState(ar);
     }
 
+    /**
+     * A link with a neighbour node. Availability information is kept as snapshots that are shared
+     * between links and with the messages they came in, so they must be detached before modifying them.
+     * Updates are sent as the changes from the last information sent, when they are smaller, and the
+     * whole information is sent again after a certain number of them. The information is reduced
+     * incrementally from the last reduction, and from scratch after a certain number of times.
+     * While the neighbour does not keep up with the messages sent to it, updates are kept waiting,
+     * so that each newer one replaces the previous one instead of piling up.
+     */
     struct Link {
         CommAddress addr;
         std::shared_ptr<T> availInfo;
         std::shared_ptr<T> waitingInfo;
         std::shared_ptr<T> notifiedInfo;
+        std::shared_ptr<T> receivedInfo;   ///< Last information received, the base of the next changes
+        std::shared_ptr<T> sentInfo;       ///< Last information sent, as the neighbour has it
+        std::shared_ptr<T> hashedInfo;     ///< Last information received through update, availInfo while it is not modified
+        uint64_t hashedPacking;            ///< Hash of the packing of hashedInfo, apart from its sequence number and origin
+        unsigned int deltasSent;           ///< Changes sent since the whole information was sent
+        bool fullRequested;                ///< Whether the neighbour asked for the whole information
+        bool delayed;                      ///< Whether the last update was kept waiting because of congestion
+        typename T::Reduction reduction;   ///< Last reduction of the information sent, to reduce the next one
         bool hasNewInformation;
-        Link() : hasNewInformation(true) {}
-        Link(const CommAddress & a) : addr(a), hasNewInformation(true) {}
+        Link() : hashedPacking(0), deltasSent(0), fullRequested(false), delayed(false), hasNewInformation(true) {}
+        Link(const CommAddress & a) : addr(a), hashedPacking(0), deltasSent(0), fullRequested(false), delayed(false), hasNewInformation(true) {}
         template<class Archive> void serializeState(Archive & ar) {
             // Serialization only works if not in a transaction
             ar & addr & availInfo & waitingInfo & notifiedInfo;
         }
         unsigned int sendUpdate() {
-            if (waitingInfo.get() && !(notifiedInfo.get() && *notifiedInfo == *waitingInfo)) {
+            delayed = false;
+            if (waitingInfo.get() && (fullRequested || !(notifiedInfo.get() && *notifiedInfo == *waitingInfo))) {
+                if (CommLayer::getInstance().isCongested(addr)) {
+                    Logger::msg("Dsp", DEBUG, "Link to ", addr, " is congested, keeping the update waiting");
+                    delayed = true;
+                    return 0;
+                }
                 if (!notifiedInfo.get()) {
                     Logger::msg("Dsp", DEBUG, "No notified info");
                 } else {
@@ -129,27 +180,57 @@ public:
                 updateSequenceNumber();
                 notifiedInfo = waitingInfo;
                 waitingInfo.reset();
-                notifiedInfo->setFromSch(false);
+                detach(notifiedInfo).setFromSch(false);
                 T * sendMsg = notifiedInfo->clone();
-                sendMsg->reduce();
-                return CommLayer::getInstance().sendMessage(addr, sendMsg);
+                if (reduction.getSteps() >= ConfigurationManager::getInstance().getIncrementalReductions())
+                    reduction.clear();
+                sendMsg->reduce(reduction);
+                return send(sendMsg);
             }
             else if (waitingInfo.get() && notifiedInfo.get())
                 Logger::msg("Dsp.Compare", DEBUG, "Notified info was equal to waiting info");
             return 0;
         }
+        /// Sends reduced information, or its changes from the last information sent if they are smaller
+        unsigned int send(T * info) {
+            unsigned int maxDeltas = ConfigurationManager::getInstance().getDeltaUpdates();
+            if (maxDeltas > 0 && sentInfo.get() && !fullRequested && deltasSent < maxDeltas) {
+                std::size_t fullSize = info->packedSize();
+                std::unique_ptr<typename T::Delta> delta(new typename T::Delta(*sentInfo, *info));
+                if (delta->packedSize() < fullSize) {
+                    // The neighbour applies the changes to the same information, with the same result
+                    sentInfo.reset(delta->apply(*sentInfo));
+                    delete info;
+                    ++deltasSent;
+                    delta->setFullSize(fullSize);
+                    Logger::msg("Dsp", DEBUG, "Sending changes ", *delta);
+                    return CommLayer::getInstance().sendMessage(addr, delta.release());
+                }
+            }
+            if (maxDeltas > 0)
+                sentInfo.reset(info->clone());
+            deltasSent = 0;
+            fullRequested = false;
+            return CommLayer::getInstance().sendMessage(addr, info);
+        }
         void updateSequenceNumber() {
             if (waitingInfo.get())
-                waitingInfo->setSeq(notifiedInfo.get() ? notifiedInfo->getSeq() + 1 : 1);
+                detach(waitingInfo).setSeq(notifiedInfo.get() ? notifiedInfo->getSeq() + 1 : 1);
         }
-        bool update(const CommAddress & src, const T & msg) {
+        bool update(const CommAddress & src, const std::shared_ptr<T> & msg) {
             if (addr == src) {
-                if (availInfo.get() && availInfo->getSeq() >= msg.getSeq()) {
-                    Logger::msg("Dsp", INFO, "Discarding old information: ", availInfo->getSeq(), " >= ", msg.getSeq());
+                if (availInfo.get() && availInfo->getSeq() >= msg->getSeq()) {
+                    Logger::msg("Dsp", INFO, "Discarding old information: ", availInfo->getSeq(), " >= ", msg->getSeq());
                 } else {
-                    // Update data
-                    availInfo.reset(msg.clone());
-                    hasNewInformation = true;
+                    // The information is only compared with the last one received if it was not modified since then
+                    uint64_t packing = packingHash(*msg);
+                    if (availInfo.get() && availInfo == hashedInfo && packing == hashedPacking) {
+                        // Nothing to aggregate again, just keep the new sequence number
+                        Logger::msg("Dsp", DEBUG, "Information did not change");
+                    } else
+                        hasNewInformation = true;
+                    availInfo = receivedInfo = hashedInfo = msg;
+                    hashedPacking = packing;
                 }
                 return true;
             }
@@ -157,6 +238,41 @@ public:
         }
     };
 
+    /**
+     * Prepares a snapshot of availability information to be modified, copying it first if it is shared.
+     * @param info The snapshot, which is replaced by its copy.
+     * @return The snapshot, not shared with anyone.
+     */
+    static T & detach(std::shared_ptr<T> & info) {
+        if (!info.unique())
+            info.reset(info->clone());
+        return *info;
+    }
+
+    /**
+     * Hashes the packing of a snapshot, apart from its sequence number and origin, so that snapshots
+     * with the same hash are packed into the same bytes. Unlike operator==, this also covers the
+     * bounds of the information. The copy shares the summary, so no cluster is copied.
+     */
+    static uint64_t packingHash(const T & info) {
+        std::unique_ptr<T> copy(info.clone());
+        copy->setSeq(0);
+        copy->setFromSch(false);
+        return PackedHash::of(*copy);
+    }
+
+    /**
+     * Obtains a snapshot of a received message, sharing it with the CommLayer.
+     */
+    static std::shared_ptr<T> share(const T & msg) {
+        try {
+            return std::static_pointer_cast<T>(std::const_pointer_cast<BasicMsg>(msg.shared_from_this()));
+        } catch (std::bad_weak_ptr &) {
+            // Not owned by a shared_ptr, it is copied as before
+            return std::shared_ptr<T>(msg.clone());
+        }
+    }
+
     /**
      * Calculates the availability information of this branch.
      */
@@ -191,11 +307,12 @@ protected:
     void handle(const CommAddress & src, const T & msg, bool delayed = false) {
         Logger::msg("Dsp", INFO, "Handling AvailabilityInformation from ", src, ": ", msg);
 
+        std::shared_ptr<T> info = share(msg);
         if (inChange) {
             // Delay this message
             Logger::msg("Dsp", DEBUG, "In the middle of a change, delaying");
-            delayedUpdates.push_back(AddrMsg(src, std::shared_ptr<T>(msg.clone())));
-        } else if ((!msg.isFromSch() && father.update(src, msg)) || child[0].update(src, msg) || child[1].update(src, msg)) {
+            delayedUpdates.push_back(AddrMsg(src, info));
+        } else if ((!msg.isFromSch() && father.update(src, info)) || child[0].update(src, info) || child[1].update(src, info)) {
             // Check if the resulting zone changes
             if (!delayed) {
                 recomputeInfo();
@@ -207,6 +324,50 @@ protected:
         }
     }
 
+    /**
+     * The changes of the availability of a subzone of the tree, from the last information received
+     * from the same node.
+     * @param src Source node address.
+     * @param msg The changes.
+     */
+    void handle(const CommAddress & src, const typename T::Delta & msg) {
+        Logger::msg("Dsp", INFO, "Handling availability changes from ", src, ": ", msg);
+        Link * link = src == father.addr ? &father : src == child[0].addr ? &child[0] : src == child[1].addr ? &child[1] : NULL;
+        if (!link) {
+            Logger::msg("Dsp", INFO, "Comes from unknown node, maybe old info?");
+            return;
+        }
+        std::shared_ptr<T> info;
+        if (link->receivedInfo.get() && link->receivedInfo->getSeq() == msg.getBaseSeq())
+            info.reset(msg.apply(*link->receivedInfo));
+        if (info.get()) {
+            link->receivedInfo = info;
+            handle(src, *info);
+        } else if (link->receivedInfo.get() && link->receivedInfo->getSeq() >= msg.getSeq()) {
+            Logger::msg("Dsp", INFO, "Discarding old changes: ", link->receivedInfo->getSeq(), " >= ", msg.getSeq());
+        } else {
+            Logger::msg("Dsp", INFO, "Changes do not apply to the last information, requesting it whole");
+            CommLayer::getInstance().sendMessage(src, new UpdateRequestMsg);
+        }
+    }
+
+    /**
+     * A request to send the whole availability information, because the last changes did not apply.
+     * @param src Source node address.
+     * @param msg UpdateRequestMsg message.
+     */
+    void handle(const CommAddress & src, const UpdateRequestMsg & msg) {
+        Logger::msg("Dsp", INFO, "Handling UpdateRequestMsg from ", src);
+        for (Link * link : {&father, &child[0], &child[1]}) {
+            if (link->addr == src && link->notifiedInfo.get()) {
+                link->fullRequested = true;
+                if (!link->waitingInfo.get())
+                    link->waitingInfo = link->notifiedInfo;
+            }
+        }
+        notify();
+    }
+
     virtual void informationUpdated() {}
 
     /**
@@ -236,12 +397,14 @@ protected:
         } else {
             // No update timer, we can send update messages
             unsigned int sentSize = 0;
+            bool delayed = false;
             if (!inChange) {
                 if (father.addr != CommAddress()) {
                     unsigned int s = father.sendUpdate();
                     if (s > 0)
                         Logger::msg("Dsp", DEBUG, "There were changes for the father, sending update");
                     sentSize += s;
+                    delayed |= father.delayed;
                 }
                 // Notify the children
                 for (int c : {0, 1}) {
@@ -250,12 +413,18 @@ protected:
                         if (s > 0)
                             Logger::msg("Dsp", DEBUG, "There were changes for the ", childName(c), " child, sending update");
                         sentSize += s;
+                        delayed |= child[c].delayed;
                     }
                 }
             }
             double ubw = ConfigurationManager::getInstance().getUpdateBandwidth();
             double t = ubw > 0.0 ? (double)sentSize / ConfigurationManager::getInstance().getUpdateBandwidth() : 0.0;
             nextUpdate = Time::getCurrentTime() + Duration(t);
+            if (delayed) {
+                // Check again in a second whether the congested links have drained
+                Time retry = Time::getCurrentTime() + Duration(1.0);
+                updateTimer = CommLayer::getInstance().setTimer(nextUpdate > retry ? nextUpdate : retry, upMsg);
+            }
         }
     }
 
@@ -34,9 +34,12 @@
 #include "FSPTaskList.hpp"
 #include "ZAFunction.hpp"
 #include "ScalarParameter.hpp"
+#include "AvailabilityDelta.hpp"
 
 namespace stars {
 
+class FSPAvailabilityDelta;
+
 /**
  * \brief Information about how slowness changes when a new application arrives.
  *
@@ -95,6 +98,11 @@ public:
 
         bool far(const MDZCluster & r) const;
 
+        static const unsigned int numCoordinates = 2;
+
+        /// Projects this cluster to the grid used by far
+        void getCoordinates(double * c) const;
+
         /// Aggregation operator for the clustering algorithm
         void aggregate(const MDZCluster & r);
 
@@ -147,10 +155,18 @@ public:
 
     MESSAGE_SUBCLASS(FSPAvailabilityInformation);
 
+    /// Type of the clusters of the summary
+    typedef MDZCluster Cluster;
+    /// Type of the changes between two versions of this information
+    typedef FSPAvailabilityDelta Delta;
+    /// Type of the clustering kept to reduce the next versions of this information
+    typedef stars::ClusteringList<MDZCluster>::Clustering Reduction;
+
     FSPAvailabilityInformation() : AvailabilityInformation() { reset();}
 
     void reset() {
         summary.clear();
+        memoryIndexValid = false;
         memoryRange.setLimits(0);
         diskRange.setLimits(0);
         minZ = maxZ = ZAFunction();
@@ -168,17 +184,30 @@ public:
         return summary;
     }
 
+    /// Replaces the clusters of the summary
+    void setSummary(std::vector<MDZCluster> && s) {
+        summary.assign(std::move(s));
+        memoryIndexValid = false;
+    }
+
     bool operator==(const FSPAvailabilityInformation & r) const {
         return summary == r.summary && slownessRange == r.slownessRange;
     }
 
     /**
      * Obtain the maximum slowness reached when allocating a set of tasks of a certain application.
+     * The clusters are found with an index by memory, which is built the first time after the
+     * summary changes, and are returned in the order of the summary. They are only read, see removeClusters.
      * @param req Application requirements.
      */
-    std::list<MDZCluster *> getFunctions(const TaskDescription & req);
+    std::list<const MDZCluster *> getFunctions(const TaskDescription & req) const;
 
-    void removeClusters(const std::list<MDZCluster *> & clusters);
+    /**
+     * Removes a set of clusters returned by getFunctions. Each one is marked in constant time,
+     * and the summary and the index are compacted once.
+     * @param clusters The clusters to remove.
+     */
+    void removeClusters(const std::list<const MDZCluster *> & clusters);
 
     void setAvailability(uint32_t m, uint32_t d, const FSPTaskList & curTasks, double power);
 
@@ -221,6 +250,12 @@ public:
     // This is documented in AvailabilityInformation.
     virtual void reduce();
 
+    /**
+     * Reduces the summary, aggregating again only the clusters that changed since a previous reduction.
+     * @param previous The previous reduction, which is updated with this one.
+     */
+    void reduce(Reduction & previous);
+
     // This is documented in BasicMsg
     virtual void output(std::ostream& os) const;
 
@@ -239,6 +274,22 @@ private:
     double lengthHorizon;                 ///< Last meaningful task length
     Interval<double> slownessRange;   /// Slowness among the nodes in this branch
     double slownessSquareDiff;
+    mutable std::vector<uint32_t> memoryIndex;    ///< Positions in the summary, by decreasing memory
+    mutable bool memoryIndexValid;                ///< Whether memoryIndex corresponds to the current summary
+
+    void buildMemoryIndex() const;
+};
+
+
+/// Changes between two versions of an FSPAvailabilityInformation
+class FSPAvailabilityDelta : public SummaryDelta<FSPAvailabilityInformation> {
+public:
+    MESSAGE_SUBCLASS(FSPAvailabilityDelta);
+
+    FSPAvailabilityDelta() {}
+
+    FSPAvailabilityDelta(const FSPAvailabilityInformation & base, const FSPAvailabilityInformation & next)
+        : SummaryDelta<FSPAvailabilityInformation>(base, next) {}
 };
 
 } // namespace stars
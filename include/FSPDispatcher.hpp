@@ -49,6 +49,12 @@ public:
         return child[c].waitingInfo;
     }
 
+    /// Tasks allocated to one cluster of a child, defined in FSPFunctionVector.hpp
+    struct FunctionInfo;
+
+    /// Allocation of tasks to the clusters of the children, defined in FSPFunctionVector.hpp
+    class FunctionVector;
+
     // TODO: Provisional
     static bool discard;
     static double discardRatio;
@@ -56,7 +62,6 @@ public:
 private:
     static double beta;
     std::list<TaskBagMsg *> delayedRequests;
-    class FunctionVector;
 
     // This is documented in Dispatcher.
     virtual void recomputeChildrenInfo();
@@ -0,0 +1,166 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FSPFUNCTIONVECTOR_H_
+#define FSPFUNCTIONVECTOR_H_
+
+#include <vector>
+#include <list>
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include "FSPDispatcher.hpp"
+#include "ZAFunction.hpp"
+
+
+struct FSPDispatcher::FunctionInfo {
+    const FSPAvailabilityInformation::MDZCluster * cluster;
+    int child;
+    double slowness;
+    int tasks;
+};
+
+
+/**
+ * \brief The clusters of both children of an FSPDispatcher, and the tasks allocated to each one.
+ */
+class FSPDispatcher::FunctionVector : public std::vector<FunctionInfo> {
+public:
+    FunctionVector(std::list<const FSPAvailabilityInformation::MDZCluster *> clusters[2], const std::array<double, 2> & bs)
+            : std::vector<FunctionInfo>(clusters[0].size() + clusters[1].size()),
+              totalTasks(0), diffWithRequest(0), minSlowness(INFINITY),
+              branchSlowness(bs), worstChild(0) {
+        size_t j = 0;
+        totalNodes = 0;
+        for (int c : {0, 1}) {
+            nodesPerBranch[c] = totalNodes;
+            for (auto i : clusters[c]) {
+                (*this)[j].cluster = i;
+                (*this)[j].child = c;
+                (*this)[j].slowness = INFINITY;
+                (*this)[j].tasks = 0;
+                totalNodes += i->getValue();
+                ++j;
+            }
+            nodesPerBranch[c] = totalNodes - nodesPerBranch[c];
+        }
+    }
+
+    /**
+     * Allocates tasks to the functions, one per node in each round, in increasing order of slowness.
+     * Every round but the last one allocates a task to every function, so only the last one is sorted.
+     */
+    void computeTasksPerFunction(unsigned int numTasksReq, uint64_t a) {
+        if (!empty()) {
+            minSlowness = 0.0;
+            if (totalTasks < numTasksReq && totalNodes > 0) {
+                unsigned int rounds = (numTasksReq - totalTasks + totalNodes - 1) / totalNodes;
+                // The task length is the same in every round, so the pieces are selected only once
+                std::vector<const stars::ZAFunction *> functions;
+                functions.reserve(size());
+                for (auto & func : *this)
+                    functions.push_back(&func.cluster->getMaximumSlowness());
+                stars::ZAFunction::SlownessBatch batch;
+                batch.select(functions, a);
+                std::vector<double> slownessOf(size());
+                if (rounds > 1) {
+                    batch.evaluate(rounds - 1, slownessOf.data());
+                    for (auto & func : *this) {
+                        func.tasks += rounds - 1;
+                        func.slowness = std::max(slownessOf[&func - data()], branchSlowness[func.child]);
+                        totalTasks += (rounds - 1) * func.cluster->getValue();
+                    }
+                }
+                batch.evaluate(rounds, slownessOf.data());
+                std::vector<std::pair<double, FunctionInfo *>> slownessHeap;
+                for (auto & func : *this) {
+                    double slowness = slownessOf[&func - data()];
+                    // Check that it is not under the minimum of its branch
+                    if (slowness < branchSlowness[func.child]) {
+                        slowness = branchSlowness[func.child];
+                    }
+                    slownessHeap.push_back(std::make_pair(slowness, &func));
+                    std::push_heap(slownessHeap.begin(), slownessHeap.end(), compare);
+                }
+                while (!slownessHeap.empty() && totalTasks < numTasksReq) {
+                    std::pop_heap(slownessHeap.begin(), slownessHeap.end(), compare);
+                    auto & func = *slownessHeap.back().second;
+                    func.tasks++;
+                    func.slowness = slownessHeap.back().first;
+                    minSlowness = func.slowness;
+                    worstChild = func.child;
+                    totalTasks += func.cluster->getValue();
+                    slownessHeap.pop_back();
+                }
+            }
+            diffWithRequest = totalTasks - numTasksReq;
+            updateBranchSlowness();
+        }
+    }
+
+    const std::array<double, 2> & getNewBranchSlowness() const { return branchSlowness; }
+
+    double getMinimumSlowness() const {
+        return minSlowness;
+    }
+
+    std::array<unsigned int, 2> computeTasksPerBranch() {
+        std::array<unsigned int, 2> tpb = {0, 0};
+        for (auto & func : *this) {
+            if (func.tasks) {
+                unsigned int tasksToCluster = func.tasks * func.cluster->getValue();
+                tpb[func.child] += tasksToCluster;
+            }
+        }
+        tpb[worstChild] -= diffWithRequest;
+        return tpb;
+    }
+
+    unsigned int getTotalNodes() const {
+        return totalNodes;
+    }
+
+    unsigned int getNodesOfBranch(int c) const {
+        return nodesPerBranch[c];
+    }
+
+private:
+    unsigned int totalTasks, diffWithRequest, totalNodes;
+    unsigned int nodesPerBranch[2];
+    double minSlowness;
+    std::array<double, 2> branchSlowness;
+    int worstChild;
+
+    static bool compare(const std::pair<double, FunctionInfo *> & l, const std::pair<double, FunctionInfo *> & r) {
+        return l.first > r.first;
+    }
+
+    void updateBranchSlowness() {
+        for (auto & func : *this) {
+            if (func.tasks) {
+                if (branchSlowness[func.child] < func.slowness) {
+                    branchSlowness[func.child] = func.slowness;
+                }
+            }
+        }
+    }
+};
+
+#endif /* FSPFUNCTIONVECTOR_H_ */
@@ -26,6 +26,9 @@
 #include "ClusteringList.hpp"
 #include "TaskDescription.hpp"
 #include "ScalarParameter.hpp"
+#include "AvailabilityDelta.hpp"
+
+class IBPAvailabilityDelta;
 
 
 /**
@@ -59,6 +62,13 @@ public:
                     minD.far(r.minD, reference->diskRange, numIntervals);
         }
 
+        static const unsigned int numCoordinates = 2;
+
+        void getCoordinates(double * c) const {
+            c[0] = minM.getCoordinate(reference->memoryRange, numIntervals);
+            c[1] = minD.getCoordinate(reference->diskRange, numIntervals);
+        }
+
         void aggregate(const MDCluster & r) {
             // Update minimums/maximums and sum up values
             minM.aggregate(value, r.minM, r.value);
@@ -123,6 +133,13 @@ public:
 
     MESSAGE_SUBCLASS(IBPAvailabilityInformation);
 
+    /// Type of the clusters of the summary
+    typedef MDCluster Cluster;
+    /// Type of the changes between two versions of this information
+    typedef IBPAvailabilityDelta Delta;
+    /// Type of the clustering kept to reduce the next versions of this information
+    typedef stars::ClusteringList<MDCluster>::Clustering Reduction;
+
     IBPAvailabilityInformation() {
         reset();
     }
@@ -147,15 +164,34 @@ public:
                 memoryRange.extend(r.memoryRange);
                 diskRange.extend(r.diskRange);
             }
-            summary.insert(summary.end(), r.summary.begin(), r.summary.end());
+            summary.append(r.summary);
         }
     }
 
     void reduce() {
+        Reduction scratch;
+        reduce(scratch);
+    }
+
+    /**
+     * Reduces the summary, aggregating again only the clusters that changed since a previous reduction.
+     * @param previous The previous reduction, which is updated with this one.
+     */
+    void reduce(Reduction & previous) {
+        summary.reuse(previous);
         for (auto & i : summary) {
             i.setReference(this);
         }
-        summary.cluster(numClusters);
+        summary.cluster(numClusters, previous, [](MDCluster &) {});
+    }
+
+    const stars::ClusteringList<MDCluster> & getSummary() const {
+        return summary;
+    }
+
+    /// Replaces the clusters of the summary
+    void setSummary(std::vector<MDCluster> && s) {
+        summary.assign(std::move(s));
     }
 
     // This is documented in AvailabilityInformation.h
@@ -163,7 +199,12 @@ public:
         return r.summary == summary;
     }
 
-    void getAvailability(std::list<MDCluster *> & clusters, const TaskDescription & req) {
+    /**
+     * Finds the clusters that fulfill a request. They are only read, see takeNodes.
+     * @param clusters The list where the clusters are put.
+     * @param req The requirements.
+     */
+    void getAvailability(std::list<const MDCluster *> & clusters, const TaskDescription & req) const {
         for (auto & i : summary) {
             if (i.fulfills(req)) {
                 clusters.push_back(&i);
@@ -171,7 +212,17 @@ public:
         }
     }
 
-    void updated() {
+    /**
+     * Takes nodes from some of the clusters returned by getAvailability, and removes the clusters left empty.
+     * @param taken Each cluster with the number of nodes taken from it.
+     */
+    void takeNodes(const std::list<std::pair<const MDCluster *, uint32_t> > & taken) {
+        std::vector<size_t> positions;
+        for (auto & t : taken)
+            positions.push_back(summary.positionOf(t.first));
+        std::vector<size_t>::iterator pos = positions.begin();
+        for (auto & t : taken)
+            summary[*pos++].takeUpToNodes(t.second);
         summary.purge();
     }
 
@@ -201,4 +252,16 @@ private:
     stars::Interval<int32_t> diskRange;
 };
 
+
+/// Changes between two versions of an IBPAvailabilityInformation
+class IBPAvailabilityDelta : public SummaryDelta<IBPAvailabilityInformation> {
+public:
+    MESSAGE_SUBCLASS(IBPAvailabilityDelta);
+
+    IBPAvailabilityDelta() {}
+
+    IBPAvailabilityDelta(const IBPAvailabilityInformation & base, const IBPAvailabilityInformation & next)
+        : SummaryDelta<IBPAvailabilityInformation>(base, next) {}
+};
+
 #endif /* IBPAVAILABILITYINFORMATION_H_ */
@@ -24,6 +24,8 @@
 #include <vector>
 #include <utility>
 #include <ostream>
+#include "util/PackedSize.hpp"
+#include "util/SmallVector.hpp"
 #include "Time.hpp"
 #include "Task.hpp"
 
@@ -32,7 +34,8 @@ namespace stars {
 class LDeltaFunction {
 public:
     typedef std::pair<Time, double> FlopsBeforeDelta;
-    typedef std::vector<FlopsBeforeDelta> PieceVector;
+    /// Points are kept inline up to the default number of pieces, so that copying a reduced function does not allocate memory
+    typedef SmallVector<FlopsBeforeDelta, 8> PieceVector;
 
     static void setNumPieces(unsigned int n) {
         numPieces = n;
@@ -147,6 +150,17 @@ public:
         return points;
     }
 
+    /**
+     * Returns the size of this function packed with msgpack, without serializing it.
+     */
+    std::size_t packedSize() const {
+        // The points and the slope; each point is an array with a time, which is an array with an integer, and a double
+        std::size_t size = 1 + PackedSizeCounter::arrayHeader(points.size()) + PackedSizeCounter::doubleSize;
+        for (auto & i : points)
+            size += 2 + PackedSizeCounter::integer(i.first.getRawDate()) + PackedSizeCounter::doubleSize;
+        return size;
+    }
+
     friend std::ostream & operator<<(std::ostream & os, const LDeltaFunction & o) {
         for (auto & i : o.points)
             os << '(' << i.first << ',' << i.second << "),";
@@ -167,6 +181,11 @@ private:
     double slope;   ///< Slope at the end of the function
 };
 
+inline msgpack::packer<PackedSizeCounter> & operator<<(msgpack::packer<PackedSizeCounter> & pk, const LDeltaFunction & f) {
+    PackedSizeCounter::add(pk, f.packedSize());
+    return pk;
+}
+
 }
 
 #endif /* LDELTAFUNCTION_HPP_ */
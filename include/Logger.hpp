@@ -23,10 +23,24 @@
 
 #include <string>
 #include <ostream>
+#include <atomic>
+#include <cstdint>
+namespace log4cpp {
+class Category;
+}
+class AsyncLogSink;
 
 
 class Logger {
 public:
+    /**
+     * The state of a category that is checked on every message, shared by all threads.
+     */
+    struct Handle {
+        std::atomic<int> priority;    ///< Chained priority of the category, messages above it are disabled
+        log4cpp::Category * category;   ///< The log4cpp category
+    };
+
     static const class Indent {
     public:
         friend std::ostream & operator<<(std::ostream & os, const Indent & r) {
@@ -51,6 +65,15 @@ public:
             end = config.find_first_of(';', start);
         }
         setPriority(config.substr(start));
+        updatePriorities();
+    }
+
+    /**
+     * Sends the enabled messages to an asynchronous sink instead of the log4cpp appenders.
+     * @param s The sink, or NULL to go back to the log4cpp appenders.
+     */
+    static void setSink(AsyncLogSink * s) {
+        sink().store(s);
     }
 
     static void setIndent(size_t n) {
@@ -61,8 +84,16 @@ public:
         Indent::active = active;
     }
 
+    /**
+     * Logs a message, if its priority is enabled in its category.
+     * @param category Category name, which must be a string literal.
+     * @param priority Priority of the message.
+     * @param params Values written to the message, with operator<<.
+     */
     template <typename... Args>
     static void msg(const char * category, int priority, const Args &... params) {
+        // Most messages are disabled, do not format them
+        if (priority > getHandle(category).priority.load(std::memory_order_relaxed)) return;
         std::ostream * out = streamIfEnabled(category, priority);
         if (out) {
             output(*out, params...);
@@ -72,6 +103,32 @@ public:
     }
 
 private:
+    static const std::size_t handleCacheSize = 256;
+
+    /**
+     * Returns the handle of a category. Category names are string literals, so the address of the
+     * name identifies the call sites that use it in a per-thread cache, and the handle is only
+     * looked up by name the first time a thread sees that address.
+     */
+    static const Handle & getHandle(const char * category) {
+        struct CacheEntry {
+            const char * name;
+            const Handle * handle;
+        };
+        static thread_local CacheEntry cache[handleCacheSize];
+        CacheEntry & e = cache[(reinterpret_cast<std::uintptr_t>(category) >> 3) % handleCacheSize];
+        if (e.name != category) {
+            e.handle = &findHandle(category);
+            e.name = category;
+        }
+        return *e.handle;
+    }
+
+    static std::atomic<AsyncLogSink *> & sink() {
+        static std::atomic<AsyncLogSink *> instance(nullptr);
+        return instance;
+    }
+
     static void output(std::ostream & out) {}
 
     template<typename T, typename... Args>
@@ -80,9 +137,12 @@ private:
         output(out, args...);
     }
 
+    static const Handle & findHandle(const char * category);
     static std::ostream * streamIfEnabled(const char * category, int priority);
     static void freeStream(std::ostream * out);
+    static void sendMessage(log4cpp::Category * category, int priority, std::string message);
     static void setPriority(const std::string & catPrio);
+    static void updatePriorities();
 };
 
 
@@ -27,6 +27,9 @@
 #include "ClusteringList.hpp"
 #include "TaskDescription.hpp"
 #include "ScalarParameter.hpp"
+#include "AvailabilityDelta.hpp"
+
+class MMPAvailabilityDelta;
 
 
 /**
@@ -74,6 +77,15 @@ public:
                     maxT.far(r.maxT, reference->queueRange, numIntervals);
         }
 
+        static const unsigned int numCoordinates = 4;
+
+        void getCoordinates(double * c) const {
+            c[0] = minM.getCoordinate(reference->memoryRange, numIntervals);
+            c[1] = minD.getCoordinate(reference->diskRange, numIntervals);
+            c[2] = minP.getCoordinate(reference->powerRange, numIntervals);
+            c[3] = maxT.getCoordinate(reference->queueRange, numIntervals);
+        }
+
         void aggregate(const MDPTCluster & r) {
             // Update minimums/maximums and sum up counts
             minM.aggregate(value, r.minM, r.value);
@@ -147,6 +159,13 @@ public:
 
     MESSAGE_SUBCLASS(MMPAvailabilityInformation);
 
+    /// Type of the clusters of the summary
+    typedef MDPTCluster Cluster;
+    /// Type of the changes between two versions of this information
+    typedef MMPAvailabilityDelta Delta;
+    /// Type of the clustering kept to reduce the next versions of this information
+    typedef stars::ClusteringList<MDPTCluster>::Clustering Reduction;
+
     MMPAvailabilityInformation() {
         reset();
     }
@@ -189,9 +208,28 @@ public:
     void join(const MMPAvailabilityInformation & o);
 
     virtual void reduce() {
+        Reduction scratch;
+        reduce(scratch);
+    }
+
+    /**
+     * Reduces the summary, aggregating again only the clusters that changed since a previous reduction.
+     * @param previous The previous reduction, which is updated with this one.
+     */
+    void reduce(Reduction & previous) {
+        summary.reuse(previous);
         for (auto & i : summary)
             i.setReference(this);
-        summary.cluster(numClusters);
+        summary.cluster(numClusters, previous, [](MDPTCluster &) {});
+    }
+
+    const stars::ClusteringList<MDPTCluster> & getSummary() const {
+        return summary;
+    }
+
+    /// Replaces the clusters of the summary
+    void setSummary(std::vector<MDPTCluster> && s) {
+        summary.assign(std::move(s));
     }
 
     // This is documented in AvailabilityInformation.h
@@ -206,9 +244,23 @@ public:
      * @param req The TaskDescription for the task.
      * @return The end time of the longest queue.
      */
-    Time getAvailability(std::list<MDPTCluster *> & clusters, unsigned int numTasks, const TaskDescription & req);
+    Time getAvailability(std::list<const MDPTCluster *> & clusters, unsigned int numTasks, const TaskDescription & req) const;
 
-    unsigned int getAvailability(std::list<MDPTCluster *> & clusters, const TaskDescription & req);
+    /**
+     * Finds the clusters with room for some task of a request before its deadline. They are only
+     * read, see updateMaximumQueue.
+     * @param clusters The list where the clusters are put.
+     * @param req The TaskDescription for the task.
+     * @return The number of tasks that fit in those clusters.
+     */
+    unsigned int getAvailability(std::list<const MDPTCluster *> & clusters, const TaskDescription & req) const;
+
+    /**
+     * Sets the end of the queue of some of the clusters returned by getAvailability.
+     * @param clusters The clusters.
+     * @param m The new end of their queues.
+     */
+    void updateMaximumQueue(const std::list<const MDPTCluster *> & clusters, Time m);
 
     void updateAvailability(const TaskDescription & req);
 
@@ -231,6 +283,18 @@ private:
     stars::Interval<Time> queueRange;
 };
 
+
+/// Changes between two versions of an MMPAvailabilityInformation
+class MMPAvailabilityDelta : public SummaryDelta<MMPAvailabilityInformation> {
+public:
+    MESSAGE_SUBCLASS(MMPAvailabilityDelta);
+
+    MMPAvailabilityDelta() {}
+
+    MMPAvailabilityDelta(const MMPAvailabilityInformation & base, const MMPAvailabilityInformation & next)
+        : SummaryDelta<MMPAvailabilityInformation>(base, next) {}
+};
+
 #endif /* MMPAVAILABILITYINFORMATION_H_ */
 
 
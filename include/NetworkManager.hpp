@@ -21,24 +21,67 @@
 #ifndef NETWORKMANAGER_H_
 #define NETWORKMANAGER_H_
 
+#include <set>
+#include <map>
+#include <deque>
+#include <vector>
+#include <memory>
 #include <boost/asio.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
 #include "Time.hpp"
 #include "CommAddress.hpp"
 #include "BasicMsg.hpp"
+#include <msgpack.hpp>
 
+/**
+ * \brief Network transport of messages.
+ *
+ * Messages to peers that understand type IDs travel over persistent connections, one per
+ * destination, as length-prefixed frames. Idle connections are closed after a timeout. Peers
+ * that do not understand them yet receive each message through its own connection, terminated
+ * by EOF, as older versions expect.
+ *
+ * Asynchronous events are handled by a configurable pool of threads, so that messages from
+ * different connections are unpacked in parallel. The handlers of each incoming connection run
+ * through its own strand, so messages from the same source, which share a connection, are still
+ * unpacked and enqueued in the order they were sent.
+ */
 class NetworkManager {
 public:
     NetworkManager();
     ~NetworkManager() {
-        if (t.get()) {
+        stop();
+    }
+
+    /**
+     * Stops the threads that handle network events, and waits for them to finish.
+     * Nothing is sent or received afterwards.
+     */
+    void stop() {
+        if (ioThreads.size()) {
             io.stop();
-            t->join();
+            ioThreads.join_all();
         }
     }
 
+    /**
+     * Sends a message to another node. It never blocks: the message is queued even if the
+     * queue of messages to that node is over its limit. Senders that can wait must check
+     * isCongested() first.
+     * @param dst Destination address.
+     * @param msg The message.
+     * @return The number of bytes sent.
+     */
     unsigned int sendMessage(const CommAddress & dst, BasicMsg * msg);
 
+    /**
+     * Checks whether the queue of messages to another node went over its limit, and has not
+     * drained yet.
+     * @param dst Destination address.
+     */
+    bool isCongested(const CommAddress & dst);
+
     CommAddress getLocalAddress() const;
 
     /**
@@ -52,23 +95,79 @@ public:
     void setAsyncTimer(Time timeout);
 
 private:
+    /// First byte of a persistent connection. It is not a valid msgpack value, so legacy connections never start with it.
+    static const uint8_t linkPreamble = 0xc1;
+    /// Bytes read from a socket at a time
+    static const std::size_t readChunkSize = 16384;
+
     /**
      * A connection between this node and another one
      */
     struct Connection {
         CommAddress dst;
         boost::asio::ip::tcp::socket socket;            ///< Socket connecting with the other node
-        boost::asio::streambuf readBuffer;    ///< Read buffer
-        boost::asio::streambuf writeBuffer;   ///< Write buffer
+        boost::asio::io_service::strand strand;         ///< Serializes the handlers of this connection
+        msgpack::unpacker pac;                ///< Read buffer, where the socket writes directly
+        std::size_t received;                 ///< Bytes received in a legacy connection
+        msgpack::sbuffer writeBuffer;         ///< Write buffer
         static const std::size_t maxReadBufferSize = 1000000;
-        Connection(boost::asio::io_service & io) : socket(io), readBuffer(maxReadBufferSize) {}
+        enum {
+            UNKNOWN,   ///< Nothing received yet
+            LEGACY,    ///< One message, terminated by EOF
+            FRAMED     ///< Persistent connection with length-prefixed messages
+        } mode;
+        bool handshakeDone;   ///< Whether the source port of a persistent connection has been read
+        Connection(boost::asio::io_service & io) : socket(io), strand(io), pac(readChunkSize), received(0), mode(UNKNOWN), handshakeDone(false) {}
         ~Connection();
     };
 
+    /**
+     * A message ready to be written on a persistent connection.
+     */
+    struct Frame {
+        /// Length prefix followed by the packed message, written in place so that it goes to the socket as is
+        msgpack::sbuffer data;
+        /// Returns the size of the frame with its prefix
+        std::size_t size() const {
+            return data.size();
+        }
+    };
+
+    /**
+     * A persistent outgoing connection to another node.
+     */
+    struct Link {
+        CommAddress dst;
+        boost::asio::ip::tcp::socket socket;         ///< Socket connecting with the other node
+        boost::asio::io_service::strand strand;      ///< Keeps the steps of a write from running along with other handlers
+        boost::asio::deadline_timer idleTimer;       ///< Timer that closes the link when it is not used
+        unsigned int idleGeneration;                 ///< Number of times the idle timer has been armed
+        std::deque<std::shared_ptr<Frame> > pending;   ///< Frames waiting to be written
+        std::vector<std::shared_ptr<Frame> > writing;  ///< Frames being written
+        std::size_t queuedBytes;                     ///< Bytes in pending and writing frames
+        bool connected;                              ///< Whether the connection has been established
+        bool handshakeSent;                          ///< Whether the preamble and source port have been written
+        bool closed;                                 ///< Whether the link has been closed and removed from the pool
+        bool congested;                              ///< Whether queuedBytes went over the send queue limit
+        uint8_t header[3];                           ///< Preamble and source port
+        uint8_t readByte;                            ///< Target of a read that detects when the peer closes the link
+        Link(boost::asio::io_service & io, const CommAddress & d) : dst(d), socket(io), strand(io), idleTimer(io), idleGeneration(0),
+                queuedBytes(0), connected(false), handshakeSent(false), closed(false), congested(false) {}
+    };
+
     // Non-copyable
     NetworkManager(const NetworkManager &);
     NetworkManager & operator=(const NetworkManager &);
 
+    /**
+     * Sends a message through a new connection, with the class name, as peers that do not
+     * understand type IDs expect.
+     */
+    unsigned int sendLegacyMessage(const CommAddress & dst, BasicMsg * msg);
+
+    /// Body of each thread of the pool
+    void runIo();
+
     /*
      * Handler for the connection with a remote node
      */
@@ -84,17 +183,78 @@ private:
      */
     void handleAccept(const boost::system::error_code & error);
 
+    /**
+     * Programs a read that writes directly into the unpacker of a connection.
+     */
+    void startRead(std::shared_ptr<Connection> c, std::size_t bytes);
+
     /**
      * Handler for the arrival of data
      */
     void handleRead(const boost::system::error_code & error, std::size_t bytes_transferred, std::shared_ptr<Connection> c);
 
-    std::unique_ptr<boost::thread> t;                 ///< Thread for the handling of asynchronous events
+    /**
+     * Unpacks the message of a legacy connection and enqueues it.
+     */
+    void readLegacyMessage(std::shared_ptr<Connection> c);
+
+    /**
+     * Unpacks and enqueues the complete frames in the read buffer of a persistent connection.
+     * @param c The connection.
+     * @param next Set to the number of bytes to read next, at least the rest of an incomplete frame.
+     * @return False if the connection must be dropped because of a protocol error.
+     */
+    bool readFrames(std::shared_ptr<Connection> c, std::size_t & next);
+
+    /**
+     * Handler for the connection of a link. The following link handlers run with linksMutex locked.
+     */
+    void handleLinkConnect(const boost::system::error_code & error, std::shared_ptr<Link> l);
+
+    /// Writes all the pending frames of a link at once
+    void startLinkWrite(std::shared_ptr<Link> l);
+
+    /// Handler for the writing of a set of frames
+    void handleLinkWrite(const boost::system::error_code & error, std::shared_ptr<Link> l);
+
+    /// Arms the idle timer of a link
+    void armLinkIdleTimer(std::shared_ptr<Link> l);
+
+    /// Handler for the expiration of the idle timer of a link
+    void handleLinkIdle(const boost::system::error_code & error, std::shared_ptr<Link> l, unsigned int generation);
+
+    /// Handler for data or EOF on a link, which the peer only sends when it closes it
+    void handleLinkRead(const boost::system::error_code & error, std::shared_ptr<Link> l);
+
+    /// Closes a link, removes it from the pool and drops its queued frames
+    void closeLink(std::shared_ptr<Link> l);
+
+    /**
+     * Handler for the expiration of the timer
+     */
+    void handleTimer(const boost::system::error_code & error);
+
+    /**
+     * Checks whether a peer is known to understand message type IDs. Until then, messages are sent
+     * to it with the class name, followed by a mark that tells it that we understand type IDs.
+     */
+    bool knowsWireIds(const CommAddress & peer) {
+        boost::mutex::scoped_lock lock(peersMutex);
+        return wireIdPeers.count(peer);
+    }
+
+    boost::thread_group ioThreads;                     ///< Threads for the handling of asynchronous events
     boost::asio::io_service io;                        ///< IO object from asio lib
     boost::asio::ip::tcp::acceptor acceptor;               ///< Acceptor for incoming connections
     std::shared_ptr<Connection> incoming;      ///< Socket for an incoming connection
 
     boost::asio::deadline_timer timer;                 ///< Timer for the TimerManager events
+
+    std::set<CommAddress> wireIdPeers;   ///< Peers that understand message type IDs
+    boost::mutex peersMutex;             ///< Mutex for wireIdPeers
+
+    std::map<CommAddress, std::shared_ptr<Link> > links;   ///< Persistent connections, by destination
+    boost::mutex linksMutex;             ///< Mutex for the links and their state
 };
 
 #endif /* NETWORKMANAGER_H_ */
@@ -95,7 +95,8 @@ public:
     ResourceNode();
     ~ResourceNode() {}
 
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg);
+    // This is documented in Service
+    const HandlerTable * getHandlers() const;
 
     /**
      * Returns the address of the father node.
@@ -53,6 +53,11 @@ public:
         return !range.empty() && getInterval(range, numIntervals) != r.getInterval(range, numIntervals);
     }
 
+    /// Coordinate of this parameter in the grid used by far; it is the same for every parameter if the range is empty
+    double getCoordinate(const interval & range, unsigned int numIntervals) const {
+        return range.empty() ? 0.0 : getInterval(range, numIntervals);
+    }
+
     unsigned int getInterval(const interval & range, unsigned int numIntervals) const {
         return std::floor((double)interval::difference(parameter, range.getMin()) * numIntervals / range.getExtent());
     }
@@ -95,7 +95,8 @@ public:
         }
     }
 
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg);
+    // This is documented in Service
+    const HandlerTable * getHandlers() const;
 
     /**
      * Tries to accept a number of tasks. If so, they are added to the list.
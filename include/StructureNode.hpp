@@ -185,7 +185,8 @@ public:
      */
     StructureNode(unsigned int fanout);
 
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg);
+    // This is documented in Service
+    const HandlerTable * getHandlers() const;
 
     virtual const CommAddress & getLeftAddress() const {
         return subZones.front()->getLink();
@@ -46,7 +46,7 @@ public:
     }
 
     // This is documented in Service
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg);
+    const HandlerTable * getHandlers() const;
 
     /**
      * Returns whether there is any ongoing application instance
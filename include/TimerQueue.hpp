@@ -0,0 +1,131 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMERQUEUE_H_
+#define TIMERQUEUE_H_
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "BasicMsg.hpp"
+#include "Time.hpp"
+
+
+/**
+ * \brief Priority queue of timers, indexed by timer ID.
+ *
+ * Timers are kept in a 4-ary heap ordered by timeout, with a map from timer ID to heap position,
+ * so that inserting and cancelling a timer are both O(log n). Timers with the same timeout are
+ * delivered in reverse order of creation.
+ */
+class TimerQueue {
+public:
+    /**
+     * A timer, which delivers a message at a specific time.
+     */
+    struct Timer {
+        static int timerId;   ///< ID counter
+
+        Time timeout;              ///< Time at which the message is to be delivered
+        std::shared_ptr<BasicMsg> msg;   ///< Message to be delivered
+        int id;                     ///< ID of this timer
+
+        /// Constructor, from a time and a message
+        Timer(Time t, std::shared_ptr<BasicMsg> m) : timeout(t), msg(m), id(++timerId) {}
+
+        /**
+        * Less operator.
+        * @param r Right operand.
+        * @return True if this timer is earlier than r.
+        */
+        bool operator<(const Timer & r) const {
+            return timeout < r.timeout;
+        }
+    };
+
+    /**
+     * Adds a new timer.
+     * @param t The timer.
+     */
+    void push(const Timer & t);
+
+    /**
+     * Removes a timer.
+     * @param id ID of the timer.
+     * @return False if there is no such timer.
+     */
+    bool cancel(int id);
+
+    /// Returns the earliest timer.
+    const Timer & top() const {
+        return heap.front();
+    }
+
+    /// Removes the earliest timer.
+    void pop() {
+        removeAt(0);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    size_t size() const {
+        return heap.size();
+    }
+
+    /**
+     * Removes every timer that fulfills a predicate.
+     * @param pred A functor that receives a Timer and returns true if it must be removed.
+     */
+    template<class Predicate> void removeIf(Predicate pred) {
+        for (size_t i = 0; i < heap.size();) {
+            if (pred(heap[i])) removeAt(i);
+            else ++i;
+        }
+    }
+
+    void clear() {
+        heap.clear();
+        position.clear();
+    }
+
+private:
+    static const size_t arity = 4;
+
+    /// Timers are ordered by timeout, and by reverse creation order when they have the same timeout
+    static bool before(const Timer & l, const Timer & r) {
+        return l.timeout < r.timeout || (l.timeout == r.timeout && l.id > r.id);
+    }
+
+    void removeAt(size_t i);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+
+    void place(size_t i, const Timer & t) {
+        heap[i] = t;
+        position[t.id] = i;
+    }
+
+    std::vector<Timer> heap;                    ///< Timers in heap order
+    std::unordered_map<int, size_t> position;   ///< Position of each timer in the heap
+};
+
+#endif /* TIMERQUEUE_H_ */
@@ -0,0 +1,41 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UPDATEREQUESTMSG_H_
+#define UPDATEREQUESTMSG_H_
+
+#include "BasicMsg.hpp"
+
+
+/**
+ * A request for the whole availability information, sent back to a dispatcher when the base
+ * of its last changes is not the information that was received from it.
+ */
+class UpdateRequestMsg : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(UpdateRequestMsg);
+
+    // This is documented in BasicMsg
+    void output(std::ostream& os) const {}
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+#endif /*UPDATEREQUESTMSG_H_*/
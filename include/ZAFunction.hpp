@@ -24,6 +24,8 @@
 #include <vector>
 #include <utility>
 #include <msgpack.hpp>
+#include "util/PackedSize.hpp"
+#include "util/SmallVector.hpp"
 #include "FSPTaskList.hpp"
 
 
@@ -78,7 +80,8 @@ public:
         float x, y, z1, z2;   // L = x/a + y*a + z1 + z2
     };
 
-    typedef std::vector<SubFunction> PieceVector;
+    /// Pieces are kept inline up to the default number of pieces, so that copying a reduced function does not allocate memory
+    typedef SmallVector<SubFunction, 10> PieceVector;
 
     enum { minTaskLength = 1000 };
 
@@ -175,6 +178,15 @@ public:
         return pieces;
     }
 
+    /**
+     * Returns the size of this function packed with msgpack. Every piece is an array of five
+     * floats, so it only depends on the number of pieces.
+     */
+    std::size_t packedSize() const {
+        return 1 + PackedSizeCounter::arrayHeader(pieces.size())
+                + pieces.size() * (1 + 5 * PackedSizeCounter::floatSize);
+    }
+
     /**
      * Returns the slowness reached for a certain application type.
      */
@@ -185,6 +197,38 @@ public:
      */
     double estimateSlowness(uint64_t a, unsigned int n) const;
 
+    /**
+     * \brief The pieces of several functions that cover the same task length.
+     *
+     * The pieces are laid out as a structure of arrays, so that the slowness of all the functions
+     * is evaluated at once, with AVX2 instructions when the processor supports them.
+     */
+    class SlownessBatch {
+    public:
+        /**
+         * Selects the piece of each function that covers tasks of length a.
+         * @param functions The functions.
+         * @param a The task length.
+         */
+        void select(const std::vector<const ZAFunction *> & functions, uint64_t a);
+
+        /**
+         * Computes the slowness of allocating n tasks to each function, with the same result
+         * as estimateSlowness(a, n), or getSlowness(a) when n is one.
+         * @param n Number of tasks per node.
+         * @param result Array that receives the slowness of each function.
+         */
+        void evaluate(unsigned int n, double * result) const;
+
+        size_t size() const {
+            return x.size();
+        }
+
+    private:
+        double length;                        ///< Task length
+        std::vector<double> x, y, z1, z2;    ///< Coefficients of the selected pieces
+    };
+
     /**
      * Reduces the availability when assigning a number of tasks with certain length
      */
@@ -206,6 +250,13 @@ private:
     // Steps through all the intervals of a pair of functions
     template<int numF, typename Func> static void stepper(const ZAFunction * (&f)[numF], Func step);
 
+    // Returns the piece that covers tasks of length a
+    const SubFunction & coveringPiece(double a) const {
+        PieceVector::const_iterator next = pieces.begin(), it = next++;
+        while (next != pieces.end() && next->covers(a)) it = next++;
+        return *it;
+    }
+
     static unsigned int numPieces;
     static unsigned int reductionQuality;
 
@@ -213,6 +264,11 @@ private:
     PieceVector pieces;
 };
 
+inline msgpack::packer<PackedSizeCounter> & operator<<(msgpack::packer<PackedSizeCounter> & pk, const ZAFunction & f) {
+    PackedSizeCounter::add(pk, f.packedSize());
+    return pk;
+}
+
 } // namespace stars
 
 #endif /* ZAFUNCTION_HPP_ */
@@ -0,0 +1,132 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LRUCACHE_H_
+#define LRUCACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include "Time.hpp"
+
+
+/**
+ * \brief Set of recently seen keys, with a maximum size and age.
+ *
+ * Keys are kept in a hash table, and chained in an intrusive list from the most to the least
+ * recently seen, so that looking up, refreshing, expiring and evicting a key are all O(1).
+ * When the set is full, the least recently seen key is evicted; keys not seen for longer than
+ * the maximum age are expired.
+ */
+template<class Key, class Hash = std::hash<Key> > class LRUCache {
+public:
+    /**
+     * Creates an empty cache.
+     * @param size Maximum number of keys.
+     * @param age Time after which a key that has not been seen again is expired.
+     */
+    LRUCache(std::size_t size, Duration age) : maxSize(size), maxAge(age), newest(NULL), oldest(NULL) {
+        entries.reserve(maxSize + 1);
+    }
+
+    /**
+     * Records that a key has been seen, expiring the keys that are too old first.
+     * @param k The key.
+     * @param now The current time.
+     * @return True if the key was already in the cache.
+     */
+    bool touch(const Key & k, Time now) {
+        expire(now);
+        std::pair<typename Map::iterator, bool> r = entries.insert(std::make_pair(k, Entry()));
+        Entry & e = r.first->second;
+        if (r.second) e.key = &r.first->first;
+        else unlink(e);
+        e.when = now;
+        pushNewest(e);
+        if (r.second && entries.size() > maxSize) remove(*oldest);
+        return !r.second;
+    }
+
+    /**
+     * Removes the keys that have not been seen for longer than the maximum age.
+     * @param now The current time.
+     */
+    void expire(Time now) {
+        while (oldest && now - oldest->when > maxAge)
+            remove(*oldest);
+    }
+
+    std::size_t size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    void clear() {
+        entries.clear();
+        newest = oldest = NULL;
+    }
+
+private:
+    /// Cache entry, linked with those seen just before and after it
+    struct Entry {
+        const Key * key;   ///< Key of this entry, owned by the table
+        Time when;         ///< Last time the key was seen
+        Entry * newer;     ///< Entry seen next, or NULL
+        Entry * older;     ///< Entry seen before, or NULL
+        Entry() : key(NULL), newer(NULL), older(NULL) {}
+    };
+
+    typedef std::unordered_map<Key, Entry, Hash> Map;
+
+    void pushNewest(Entry & e) {
+        e.older = newest;
+        e.newer = NULL;
+        if (newest) newest->newer = &e;
+        else oldest = &e;
+        newest = &e;
+    }
+
+    void unlink(Entry & e) {
+        if (e.older) e.older->newer = e.newer;
+        else oldest = e.newer;
+        if (e.newer) e.newer->older = e.older;
+        else newest = e.older;
+    }
+
+    void remove(Entry & e) {
+        unlink(e);
+        entries.erase(entries.find(*e.key));
+    }
+
+    std::size_t maxSize;
+    Duration maxAge;
+    Map entries;      ///< Entries by key; references to them stay valid while they are in the table
+    Entry * newest;   ///< Most recently seen entry
+    Entry * oldest;   ///< Least recently seen entry, the first to expire
+
+    // Non-copyable, the entries are linked with pointers into the table
+    LRUCache(const LRUCache &);
+    LRUCache & operator=(const LRUCache &);
+};
+
+#endif /* LRUCACHE_H_ */
@@ -0,0 +1,232 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPSCQUEUE_H_
+#define MPSCQUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <deque>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/thread.hpp>
+
+
+/**
+ * \brief Multi-producer, single-consumer queue.
+ *
+ * Lock-free ring buffer in which every slot carries a sequence number, so that producers
+ * only contend on the CAS of the enqueue position and the consumer never takes a lock while
+ * there are items. The consumer only blocks when the ring is empty; producers check a
+ * sleeping flag after publishing and only signal the consumer on the empty to non-empty
+ * transition, so the mutex and condition are kept out of the fast path.
+ *
+ * The ring has a fixed capacity. When it is full, push() moves the item to an overflow list
+ * instead of waiting, so that it never blocks, not even on the consumer thread; that list has
+ * no bound, so the queue as a whole is unbounded. While the overflow list is not empty, every
+ * new item goes there too, so that the items of each producer keep their order; the consumer
+ * only takes items from the overflow list when every position claimed in the ring has been
+ * consumed.
+ */
+template <class T> class MPSCQueue {
+public:
+    static const std::size_t cacheLineSize = 64;
+
+    /**
+     * Creates a queue with a certain capacity, rounded up to the next power of two.
+     * @param minCapacity Minimum number of items that the queue can hold.
+     */
+    explicit MPSCQueue(std::size_t minCapacity) : capacity(roundUp(minCapacity)), mask(capacity - 1),
+            cells(new Cell[capacity]), enqueuePos(0), dequeuePos(0), sleeping(false), overflowing(false) {
+        for (std::size_t i = 0; i < capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * Puts an item in the queue, if there is room for it. Can be called from any thread.
+     * @param item The item to be inserted.
+     * @return False if the ring is full or items are waiting in the overflow list.
+     */
+    bool tryPush(T && item) {
+        if (overflowing.load(std::memory_order_acquire)) return false;
+        Cell * cell;
+        std::size_t pos = enqueuePos.value.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+            if (diff == 0) {
+                if (enqueuePos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.value.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        wakeIfSleeping();
+        return true;
+    }
+
+    /**
+     * Puts an item in the queue, in the overflow list if the ring is full. It never blocks
+     * waiting for room, so it can be called from any thread, including the consumer's.
+     * @param item The item to be inserted.
+     */
+    void push(T item) {
+        if (!tryPush(std::move(item))) {
+            {
+                boost::mutex::scoped_lock lock(overflowMutex);
+                overflow.push_back(std::move(item));
+                overflowing.store(true, std::memory_order_release);
+            }
+            wakeIfSleeping();
+        }
+    }
+
+    /**
+     * Takes the next item from the queue, if there is any. Must only be called from the consumer thread.
+     * @param item The variable that receives the item.
+     * @return False if the queue is empty, or the next item of the ring is still being written.
+     */
+    bool tryPop(T & item) {
+        std::size_t pos = dequeuePos.value.load(std::memory_order_relaxed);
+        Cell * cell = &cells[pos & mask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if ((std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1) < 0) {
+            // A claimed position that is not published yet may precede items of the overflow list
+            if (enqueuePos.value.load(std::memory_order_acquire) != pos)
+                return false;
+            return overflowing.load(std::memory_order_acquire) && tryPopOverflow(item);
+        }
+        item = std::move(cell->data);
+        cell->data = T();
+        dequeuePos.value.store(pos + 1, std::memory_order_relaxed);
+        cell->sequence.store(pos + capacity, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Takes the next item from the queue, waiting for it if the queue is empty. Must only
+     * be called from the consumer thread.
+     * @param item The variable that receives the item.
+     * @param cancel Flag that makes this method return without an item when it is set.
+     * @return False if the wait was cancelled.
+     */
+    bool pop(T & item, const std::atomic<bool> & cancel) {
+        if (cancel.load()) return false;
+        if (tryPop(item)) return true;
+        boost::mutex::scoped_lock lock(sleepMutex);
+        for (;;) {
+            sleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (cancel.load()) {
+                sleeping.store(false);
+                return false;
+            }
+            if (tryPop(item)) {
+                sleeping.store(false);
+                return true;
+            }
+            nonEmpty.wait(lock);
+        }
+    }
+
+    /**
+     * Wakes up the consumer if it is blocked in pop(), so that it checks its cancel flag.
+     */
+    void wakeConsumer() {
+        boost::mutex::scoped_lock lock(sleepMutex);
+        nonEmpty.notify_all();
+    }
+
+    /**
+     * Checks whether the queue is empty. It is only accurate when called from the consumer thread.
+     */
+    bool empty() const {
+        std::size_t pos = dequeuePos.value.load(std::memory_order_relaxed);
+        return (std::ptrdiff_t)cells[pos & mask].sequence.load(std::memory_order_acquire) - (std::ptrdiff_t)(pos + 1) < 0
+                && !overflowing.load(std::memory_order_acquire);
+    }
+
+    /// Returns the number of items in the ring, beyond which they go to the overflow list.
+    std::size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    /// A slot of the ring, with the sequence number that tells who owns it
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    /// A value alone in its cache line, to avoid false sharing
+    struct alignas(cacheLineSize) PaddedPos {
+        std::atomic<std::size_t> value;
+        PaddedPos(std::size_t v) : value(v) {}
+    };
+
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t result = 2;
+        while (result < n) result <<= 1;
+        return result;
+    }
+
+    /// Takes the first item of the overflow list, and lets producers use the ring again when it is empty
+    bool tryPopOverflow(T & item) {
+        boost::mutex::scoped_lock lock(overflowMutex);
+        if (overflow.empty()) return false;
+        item = std::move(overflow.front());
+        overflow.pop_front();
+        if (overflow.empty())
+            overflowing.store(false, std::memory_order_release);
+        return true;
+    }
+
+    void wakeIfSleeping() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+            boost::mutex::scoped_lock lock(sleepMutex);
+            nonEmpty.notify_one();
+        }
+    }
+
+    const std::size_t capacity;
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    PaddedPos enqueuePos;        ///< Next position to be written by producers
+    PaddedPos dequeuePos;        ///< Next position to be read by the consumer
+    alignas(cacheLineSize) std::atomic<bool> sleeping;   ///< True when the consumer may be blocked
+    boost::mutex sleepMutex;     ///< Mutex for the slow path of pop()
+    boost::condition nonEmpty;   ///< Condition to wake up the consumer
+    alignas(cacheLineSize) std::atomic<bool> overflowing;  ///< True while there are items in the overflow list
+    boost::mutex overflowMutex;  ///< Mutex for the overflow list
+    std::deque<T> overflow;      ///< Items that did not fit in the ring, in order
+
+    // Non-copyable
+    MPSCQueue(const MPSCQueue &);
+    MPSCQueue & operator=(const MPSCQueue &);
+};
+
+#endif /* MPSCQUEUE_H_ */
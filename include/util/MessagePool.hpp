@@ -0,0 +1,241 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MESSAGEPOOL_H_
+#define MESSAGEPOOL_H_
+
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <boost/thread/mutex.hpp>
+
+
+/**
+ * \brief Per-thread free lists of fixed-size blocks for messages.
+ *
+ * Messages are created and destroyed all the time, with only a few different sizes. Released
+ * blocks are kept in a list per size and thread, and the next allocation of the same size in
+ * that thread takes them back without going through the global allocator or taking any lock.
+ *
+ * A block released by a thread other than the one that allocated it goes to the list of the
+ * releasing thread. When that list is full, half of it moves to a list shared by all threads,
+ * where a thread whose own list is empty takes its blocks from. This way, blocks of messages
+ * that are created by the network threads and destroyed by the event loop return to the former.
+ * The shared list is bounded too, and the blocks beyond the limit are freed.
+ */
+class MessagePool {
+public:
+    /// Allocation counters of a thread
+    struct Stats {
+        unsigned long int allocations;   ///< Blocks allocated through the pool
+        unsigned long int reused;        ///< Blocks taken from a free list
+        unsigned long int transferred;   ///< Blocks taken from the shared list
+        Stats() : allocations(0), reused(0), transferred(0) {}
+    };
+
+    /// Block sizes are rounded up to a multiple of this value, so that similar types share lists
+    static const std::size_t granularity = 16;
+    /// Maximum number of free blocks of each size kept by a thread
+    static const std::size_t maxFreeBlocks = 4096;
+    /// Number of blocks moved at a time between the list of a thread and the shared one
+    static const std::size_t transferBlocks = maxFreeBlocks / 2;
+    /// Maximum number of free blocks of each size in the shared list
+    static const std::size_t maxSharedBlocks = 4 * maxFreeBlocks;
+
+    /**
+     * Allocates a block for an object of a certain size.
+     */
+    template<std::size_t Size> static void * allocate() {
+        // Even without the pool, blocks have the rounded size, in case it is enabled before they are released
+        if (!isEnabled()) return ::operator new(blockSize(Size));
+        FreeList<blockSize(Size)> & list = FreeList<blockSize(Size)>::local();
+        Stats & stats = getThreadStats();
+        ++stats.allocations;
+        if (!list.head)
+            stats.transferred += SharedList<blockSize(Size)>::instance().take(list);
+        if (list.head) {
+            ++stats.reused;
+            Block * b = list.head;
+            list.head = b->next;
+            --list.length;
+            return b;
+        }
+        return ::operator new(blockSize(Size));
+    }
+
+    /**
+     * Releases a block obtained with allocate() of the same size, maybe in another thread.
+     */
+    template<std::size_t Size> static void release(void * p) {
+        FreeList<blockSize(Size)> & list = FreeList<blockSize(Size)>::local();
+        if (!isEnabled() || list.closed) {
+            ::operator delete(p);
+        } else {
+            if (list.length >= maxFreeBlocks)
+                SharedList<blockSize(Size)>::instance().give(list);
+            Block * b = static_cast<Block *>(p);
+            b->next = list.head;
+            list.head = b;
+            ++list.length;
+        }
+    }
+
+    /**
+     * Enables or disables the pool. When disabled, blocks come from and return to the global
+     * allocator, to compare both.
+     */
+    static void setEnabled(bool e) {
+        enabled().store(e, std::memory_order_relaxed);
+    }
+
+    static bool isEnabled() {
+        return enabled().load(std::memory_order_relaxed);
+    }
+
+    /// Returns the allocation counters of the calling thread
+    static Stats & getThreadStats() {
+        static thread_local Stats stats;
+        return stats;
+    }
+
+    /**
+     * \brief Allocator for std::allocate_shared, so that the object and its reference counts share a pooled block.
+     */
+    template<class T> class Allocator {
+    public:
+        typedef T value_type;
+        template<class U> struct rebind {
+            typedef Allocator<U> other;
+        };
+
+        Allocator() {}
+        template<class U> Allocator(const Allocator<U> &) {}
+
+        T * allocate(std::size_t n) {
+            return n == 1 ? static_cast<T *>(MessagePool::allocate<sizeof(T)>())
+                    : static_cast<T *>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T * p, std::size_t n) {
+            if (n == 1) MessagePool::release<sizeof(T)>(p);
+            else ::operator delete(p);
+        }
+
+        template<class U> bool operator==(const Allocator<U> &) const {
+            return true;
+        }
+
+        template<class U> bool operator!=(const Allocator<U> &) const {
+            return false;
+        }
+    };
+
+private:
+    struct Block {
+        Block * next;
+    };
+
+    template<std::size_t Size> struct FreeList {
+        Block * head;
+        std::size_t length;
+        bool closed;   ///< Set when the thread is exiting, later releases go to the global allocator
+
+        FreeList() : head(NULL), length(0), closed(false) {}
+
+        ~FreeList() {
+            closed = true;
+            while (head) {
+                Block * b = head;
+                head = b->next;
+                ::operator delete(b);
+            }
+        }
+
+        static FreeList & local() {
+            static thread_local FreeList instance;
+            return instance;
+        }
+    };
+
+    /// List of free blocks shared by all threads, protected by a mutex
+    template<std::size_t Size> struct SharedList {
+        boost::mutex mutex;
+        Block * head;
+        std::size_t length;
+
+        SharedList() : head(NULL), length(0) {}
+
+        /// Moves transferBlocks blocks from the list of a thread, or frees them if this one is full
+        void give(FreeList<Size> & list) {
+            Block * first = list.head, * last = first;
+            for (std::size_t i = 1; i < transferBlocks; ++i)
+                last = last->next;
+            list.head = last->next;
+            list.length -= transferBlocks;
+            boost::mutex::scoped_lock lock(mutex);
+            if (length + transferBlocks > maxSharedBlocks) {
+                lock.unlock();
+                last->next = NULL;
+                while (first) {
+                    Block * b = first;
+                    first = b->next;
+                    ::operator delete(b);
+                }
+            } else {
+                last->next = head;
+                head = first;
+                length += transferBlocks;
+            }
+        }
+
+        /// Moves up to transferBlocks blocks to the empty list of a thread, and returns how many
+        std::size_t take(FreeList<Size> & list) {
+            boost::mutex::scoped_lock lock(mutex);
+            if (!head) return 0;
+            std::size_t n = 1;
+            Block * last = head;
+            for (; n < transferBlocks && last->next; ++n)
+                last = last->next;
+            list.head = head;
+            list.length = n;
+            head = last->next;
+            last->next = NULL;
+            length -= n;
+            return n;
+        }
+
+        /// Never destroyed, since threads may release blocks while the program exits
+        static SharedList & instance() {
+            static SharedList * instance = new SharedList;
+            return *instance;
+        }
+    };
+
+    static constexpr std::size_t blockSize(std::size_t size) {
+        return size < sizeof(Block) ? sizeof(Block) : (size + granularity - 1) / granularity * granularity;
+    }
+
+    static std::atomic<bool> & enabled() {
+        static std::atomic<bool> instance(true);
+        return instance;
+    }
+};
+
+#endif /* MESSAGEPOOL_H_ */
@@ -0,0 +1,64 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKEDHASH_H_
+#define PACKEDHASH_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <msgpack.hpp>
+
+
+/**
+ * \brief Output of a msgpack packer that hashes the bytes instead of keeping them.
+ *
+ * Objects that are packed into the same bytes get the same hash, without building a buffer
+ * with them. It is a 64-bit FNV-1a hash.
+ */
+class PackedHash {
+public:
+    PackedHash() : hash(offsetBasis) {}
+
+    void write(const char * buf, std::size_t len) {
+        for (const char * c = buf; c < buf + len; ++c)
+            hash = (hash ^ (unsigned char)*c) * prime;
+    }
+
+    /// Returns the hash of the bytes packed so far
+    uint64_t getHash() const {
+        return hash;
+    }
+
+    /// Returns the hash of the packing of an object
+    template<class T> static uint64_t of(const T & o) {
+        PackedHash h;
+        msgpack::packer<PackedHash> pk(&h);
+        pk.pack(o);
+        return h.getHash();
+    }
+
+private:
+    static const uint64_t offsetBasis = 14695981039346656037ULL;
+    static const uint64_t prime = 1099511628211ULL;
+
+    uint64_t hash;
+};
+
+#endif /* PACKEDHASH_H_ */
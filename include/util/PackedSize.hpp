@@ -0,0 +1,75 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKEDSIZE_H_
+#define PACKEDSIZE_H_
+
+#include <cstddef>
+#include <stdint.h>
+#include <msgpack.hpp>
+
+
+/**
+ * \brief Output of a msgpack packer that only counts bytes.
+ *
+ * Packing into it follows the same encoding rules as packing into a real buffer, but nothing is
+ * copied, so it gives the size of an object much faster than serializing it. Types whose size
+ * can be computed directly may bypass it with an overload of operator<< for
+ * msgpack::packer<PackedSizeCounter> that calls add().
+ */
+class PackedSizeCounter {
+public:
+    PackedSizeCounter() : size(0) {}
+
+    void write(const char * buf, std::size_t len) {
+        size += len;
+    }
+
+    /// Returns the number of bytes packed so far
+    std::size_t getSize() const {
+        return size;
+    }
+
+    /// Accounts for n bytes without packing them
+    static void add(msgpack::packer<PackedSizeCounter> & pk, std::size_t n) {
+        pk.pack_raw_body(NULL, n);
+    }
+
+    /// Size of the header of an array with n elements
+    static std::size_t arrayHeader(std::size_t n) {
+        return n < 16 ? 1 : n < 65536 ? 3 : 5;
+    }
+
+    /// Size of a signed integer, which msgpack packs in the shortest form that holds its value
+    static std::size_t integer(int64_t v) {
+        if (v < -(1LL << 5))
+            return v < -(1LL << 31) ? 9 : v < -(1LL << 15) ? 5 : v < -(1LL << 7) ? 3 : 2;
+        else if (v < (1LL << 7)) return 1;
+        else return v < (1LL << 8) ? 2 : v < (1LL << 16) ? 3 : v < (1LL << 32) ? 5 : 9;
+    }
+
+    static const std::size_t floatSize = 5;    ///< Size of a float
+    static const std::size_t doubleSize = 9;   ///< Size of a double
+
+private:
+    std::size_t size;
+};
+
+#endif /* PACKEDSIZE_H_ */
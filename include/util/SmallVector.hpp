@@ -0,0 +1,335 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMALLVECTOR_H_
+#define SMALLVECTOR_H_
+
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <msgpack.hpp>
+
+
+/**
+ * \brief Vector that keeps up to N elements inline.
+ *
+ * It behaves like the subset of std::vector that the availability functions use, but its first
+ * N elements live inside the object, so that copying a short vector does not allocate memory.
+ * When it grows beyond N elements, the elements are moved to the heap, as in std::vector.
+ * Unlike std::vector, moving or swapping an inline vector moves its elements, so iterators
+ * are not preserved.
+ */
+template<class T, std::size_t N> class SmallVector {
+    static_assert(N > 0, "SmallVector needs room for at least one inline element");
+public:
+    typedef T value_type;
+    typedef T & reference;
+    typedef const T & const_reference;
+    typedef T * iterator;
+    typedef const T * const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    SmallVector() : elems(inlineElems()), numElems(0), cap(N) {}
+
+    SmallVector(const SmallVector & copy) : elems(inlineElems()), numElems(0), cap(N) {
+        append(copy.begin(), copy.end(), std::random_access_iterator_tag());
+    }
+
+    SmallVector(SmallVector && move) : elems(inlineElems()), numElems(0), cap(N) {
+        steal(move);
+    }
+
+    template<class InputIterator> SmallVector(InputIterator first, InputIterator last)
+            : elems(inlineElems()), numElems(0), cap(N) {
+        assign(first, last);
+    }
+
+    ~SmallVector() {
+        clear();
+        release();
+    }
+
+    SmallVector & operator=(const SmallVector & copy) {
+        if (this != &copy) {
+            clear();
+            append(copy.begin(), copy.end(), std::random_access_iterator_tag());
+        }
+        return *this;
+    }
+
+    SmallVector & operator=(SmallVector && move) {
+        if (this != &move) {
+            clear();
+            release();
+            steal(move);
+        }
+        return *this;
+    }
+
+    iterator begin() { return elems; }
+    const_iterator begin() const { return elems; }
+    iterator end() { return elems + numElems; }
+    const_iterator end() const { return elems + numElems; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    size_type size() const { return numElems; }
+    size_type capacity() const { return cap; }
+    bool empty() const { return numElems == 0; }
+    /// Whether the elements are stored inside the object
+    bool isInline() const { return elems == inlineElems(); }
+
+    T * data() { return elems; }
+    const T * data() const { return elems; }
+    T & operator[](size_type i) { return elems[i]; }
+    const T & operator[](size_type i) const { return elems[i]; }
+    T & front() { return elems[0]; }
+    const T & front() const { return elems[0]; }
+    T & back() { return elems[numElems - 1]; }
+    const T & back() const { return elems[numElems - 1]; }
+
+    void reserve(size_type n) {
+        if (n > cap) {
+            n = std::max(n, cap * 2);
+            T * newElems = static_cast<T *>(::operator new(n * sizeof(T)));
+            std::uninitialized_copy(std::make_move_iterator(begin()), std::make_move_iterator(end()), newElems);
+            destroy(begin(), end());
+            release();
+            elems = newElems;
+            cap = n;
+            ++heapAllocations;
+        }
+    }
+
+    void push_back(const T & v) {
+        if (numElems == cap) {
+            // v may be an element of this vector
+            T copy(v);
+            grow();
+            new(elems + numElems) T(std::move(copy));
+        } else new(elems + numElems) T(v);
+        ++numElems;
+    }
+
+    void push_back(T && v) {
+        if (numElems == cap) {
+            T copy(std::move(v));
+            grow();
+            new(elems + numElems) T(std::move(copy));
+        } else new(elems + numElems) T(std::move(v));
+        ++numElems;
+    }
+
+    template<class... Args> void emplace_back(Args &&... args) {
+        push_back(T(std::forward<Args>(args)...));
+    }
+
+    void pop_back() {
+        elems[--numElems].~T();
+    }
+
+    void clear() {
+        destroy(begin(), end());
+        numElems = 0;
+    }
+
+    void resize(size_type n) {
+        resize(n, T());
+    }
+
+    void resize(size_type n, const T & v) {
+        if (n < numElems) {
+            destroy(begin() + n, end());
+            numElems = n;
+        } else if (n > numElems) {
+            T copy(v);
+            reserve(n);
+            std::uninitialized_fill(end(), begin() + n, copy);
+            numElems = n;
+        }
+    }
+
+    /// As in std::vector, the range must not point into this vector
+    template<class InputIterator> void assign(InputIterator first, InputIterator last) {
+        clear();
+        append(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
+    }
+
+    /// As in std::vector, the range must not point into this vector
+    template<class InputIterator> iterator insert(const_iterator pos, InputIterator first, InputIterator last) {
+        size_type offset = pos - begin(), oldSize = numElems;
+        append(first, last, typename std::iterator_traits<InputIterator>::iterator_category());
+        std::rotate(begin() + offset, begin() + oldSize, end());
+        return begin() + offset;
+    }
+
+    iterator insert(const_iterator pos, const T & v) {
+        size_type offset = pos - begin();
+        push_back(v);
+        std::rotate(begin() + offset, end() - 1, end());
+        return begin() + offset;
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        iterator f = begin() + (first - begin()), l = begin() + (last - begin());
+        iterator newEnd = std::move(l, end(), f);
+        destroy(newEnd, end());
+        numElems = newEnd - begin();
+        return f;
+    }
+
+    iterator erase(const_iterator pos) {
+        return erase(pos, pos + 1);
+    }
+
+    void swap(SmallVector & r) {
+        if (!isInline() && !r.isInline()) {
+            std::swap(elems, r.elems);
+            std::swap(numElems, r.numElems);
+            std::swap(cap, r.cap);
+        } else {
+            SmallVector tmp(std::move(r));
+            r = std::move(*this);
+            *this = std::move(tmp);
+        }
+    }
+
+    bool operator==(const SmallVector & r) const {
+        return numElems == r.numElems && std::equal(begin(), end(), r.begin());
+    }
+
+    bool operator!=(const SmallVector & r) const {
+        return !(*this == r);
+    }
+
+    /// Number of times that any SmallVector of this type has allocated memory in the current thread
+    static unsigned long int getHeapAllocations() {
+        return heapAllocations;
+    }
+
+private:
+    T * inlineElems() {
+        return reinterpret_cast<T *>(&storage);
+    }
+
+    const T * inlineElems() const {
+        return reinterpret_cast<const T *>(&storage);
+    }
+
+    static void destroy(iterator first, iterator last) {
+        for (; first != last; ++first)
+            first->~T();
+    }
+
+    void grow() {
+        reserve(cap * 2);
+    }
+
+    template<class InputIterator> void append(InputIterator first, InputIterator last, std::input_iterator_tag) {
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+
+    template<class ForwardIterator> void append(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+        size_type n = std::distance(first, last);
+        reserve(numElems + n);
+        std::uninitialized_copy(first, last, end());
+        numElems += n;
+    }
+
+    /// Frees the heap memory, if any, and goes back to the inline storage; the vector must be empty
+    void release() {
+        if (!isInline()) {
+            ::operator delete(elems);
+            elems = inlineElems();
+            cap = N;
+        }
+    }
+
+    /// Takes the elements of another vector, which is left empty; this one must be empty and inline
+    void steal(SmallVector & move) {
+        if (move.isInline()) {
+            std::uninitialized_copy(std::make_move_iterator(move.begin()), std::make_move_iterator(move.end()), elems);
+            numElems = move.numElems;
+            move.clear();
+        } else {
+            elems = move.elems;
+            numElems = move.numElems;
+            cap = move.cap;
+            move.elems = move.inlineElems();
+            move.numElems = 0;
+            move.cap = N;
+        }
+    }
+
+    typename std::aligned_storage<N * sizeof(T), std::alignment_of<T>::value>::type storage;
+    T * elems;            ///< Pointer to the elements, either the inline storage or the heap
+    size_type numElems;   ///< Number of elements
+    size_type cap;        ///< Number of elements that fit in the current storage
+
+    static thread_local unsigned long int heapAllocations;
+};
+
+template<class T, std::size_t N> thread_local unsigned long int SmallVector<T, N>::heapAllocations = 0;
+
+
+namespace msgpack {
+
+template<class T, std::size_t N> inline SmallVector<T, N> & operator>>(object o, SmallVector<T, N> & v) {
+    if (o.type != type::ARRAY) throw type_error();
+    v.resize(o.via.array.size);
+    for (uint32_t i = 0; i < o.via.array.size; ++i)
+        o.via.array.ptr[i].convert(&v[i]);
+    return v;
+}
+
+template<class Stream, class T, std::size_t N> inline packer<Stream> & operator<<(packer<Stream> & o, const SmallVector<T, N> & v) {
+    o.pack_array(v.size());
+    for (auto & i : v)
+        o.pack(i);
+    return o;
+}
+
+template<class T, std::size_t N> inline void operator<<(object::with_zone & o, const SmallVector<T, N> & v) {
+    o.type = type::ARRAY;
+    if (v.empty()) {
+        o.via.array.ptr = NULL;
+        o.via.array.size = 0;
+    } else {
+        object * p = (object *)o.zone->malloc(sizeof(object) * v.size());
+        o.via.array.ptr = p;
+        o.via.array.size = v.size();
+        for (auto & i : v)
+            *(p++) = object(i, o.zone);
+    }
+}
+
+} // namespace msgpack
+
+#endif /* SMALLVECTOR_H_ */
@@ -0,0 +1,117 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+
+#include <functional>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+
+/**
+ * \brief Threads that run a job along with the calling thread.
+ *
+ * The threads are created the first time they are needed and then wait for the next job, so
+ * that a job that is run very often does not create and join its threads every time. There is
+ * one pool for the whole process, and it runs one job at a time.
+ */
+class WorkerPool {
+public:
+    /// Returns the pool of the process
+    static WorkerPool & getInstance() {
+        static WorkerPool instance;
+        return instance;
+    }
+
+    ~WorkerPool() {
+        {
+            boost::mutex::scoped_lock lock(m);
+            exiting = true;
+        }
+        start.notify_all();
+        workers.join_all();
+    }
+
+    /**
+     * Runs a job in several threads, the calling one and n - 1 workers, and waits for all of them.
+     * @param n Number of threads, at least one.
+     * @param job The job, which each thread runs once.
+     */
+    void run(unsigned int n, const std::function<void()> & job) {
+        boost::mutex::scoped_lock serial(runMutex);
+        {
+            boost::mutex::scoped_lock lock(m);
+            // New workers start waiting for this job
+            for (; numWorkers < n - 1; ++numWorkers)
+                workers.create_thread(std::bind(&WorkerPool::work, this, numWorkers, generation));
+            current = &job;
+            wanted = running = n - 1;
+            ++generation;
+        }
+        start.notify_all();
+        job();
+        boost::mutex::scoped_lock lock(m);
+        while (running > 0)
+            done.wait(lock);
+        current = NULL;
+    }
+
+private:
+    WorkerPool() : current(NULL), numWorkers(0), wanted(0), running(0), generation(0), exiting(false) {}
+
+    // Non-copyable
+    WorkerPool(const WorkerPool &);
+    WorkerPool & operator=(const WorkerPool &);
+
+    /// Body of each worker, which runs every job that needs it after the given generation
+    void work(unsigned int index, unsigned long int seen) {
+        boost::mutex::scoped_lock lock(m);
+        while (true) {
+            while (!exiting && generation == seen)
+                start.wait(lock);
+            if (exiting) return;
+            seen = generation;
+            if (index < wanted) {
+                const std::function<void()> & job = *current;
+                lock.unlock();
+                job();
+                lock.lock();
+                if (--running == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    boost::thread_group workers;             ///< The worker threads
+    boost::mutex runMutex;                   ///< Serializes the jobs
+    boost::mutex m;                          ///< Protects the state of the current job
+    boost::condition_variable start;         ///< Signals a new job, or the end of the pool
+    boost::condition_variable done;          ///< Signals that every worker finished the current job
+    const std::function<void()> * current;   ///< The current job
+    unsigned int numWorkers;                 ///< Number of worker threads
+    unsigned int wanted;                     ///< Number of workers that run the current job
+    unsigned int running;                    ///< Workers that have not finished the current job yet
+    unsigned long int generation;            ///< Number of jobs run
+    bool exiting;                            ///< Whether the workers must finish
+};
+
+#endif /* WORKERPOOL_H_ */
@@ -0,0 +1,225 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <log4cpp/Priority.hh>
+#include "AsyncLogSink.hpp"
+
+
+/// Ring buffer of the records of a thread, written by that thread and read by the background thread
+class AsyncLogSink::Buffer {
+public:
+    struct Record {
+        Time when;
+        const std::string * category;
+        int priority;
+        std::string message;
+
+        bool operator<(const Record & r) const {
+            return when < r.when;
+        }
+    };
+
+    explicit Buffer(std::size_t minSize) : closed(false), size(roundUp(minSize)), mask(size - 1),
+            records(new Record[size]), head(0), tail(0) {}
+
+    /**
+     * Appends a record, if there is room for it. Only called by the owner thread.
+     * @return False if the buffer is full, and then the record is not moved.
+     */
+    bool tryPush(Record & r) {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= size) return false;
+        records[t & mask] = std::move(r);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns whether the buffer is at least half full.
+    bool halfFull() const {
+        return (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed)) * 2 >= size;
+    }
+
+    /**
+     * Takes all the records in the buffer. Only called by the background thread.
+     * @param out Vector where the records are appended.
+     */
+    void popAll(std::vector<Record> & out) {
+        std::size_t h = head.load(std::memory_order_relaxed), t = tail.load(std::memory_order_acquire);
+        for (; h != t; ++h)
+            out.push_back(std::move(records[h & mask]));
+        head.store(t, std::memory_order_release);
+    }
+
+    bool empty() const {
+        return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+    }
+
+    std::atomic<bool> closed;   ///< Set when the owner thread exits, it will not append more records
+
+private:
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t result = 2;
+        while (result < n) result <<= 1;
+        return result;
+    }
+
+    const std::size_t size;
+    const std::size_t mask;
+    std::unique_ptr<Record[]> records;
+    alignas(64) std::atomic<std::size_t> head;   ///< Next record to be read
+    alignas(64) std::atomic<std::size_t> tail;   ///< Next record to be written
+};
+
+
+static std::atomic<unsigned int> lastSinkId(0);
+
+
+AsyncLogSink::AsyncLogSink(const boost::filesystem::path & fileName, std::size_t size, OverflowPolicy p,
+        Duration period) : bufferSize(size), policy(p), flushPeriod(period), id(++lastSinkId),
+        file(fileName, std::ios_base::out | std::ios_base::app), stopping(false), finished(false),
+        appending(0), dropped(0), reportedDropped(0) {
+    writer = boost::thread(&AsyncLogSink::run, this);
+}
+
+
+AsyncLogSink::Buffer & AsyncLogSink::getLocalBuffer() {
+    // A thread keeps a reference to its buffer, and releases it when it exits
+    struct Reference {
+        unsigned int sinkId;
+        std::shared_ptr<Buffer> buffer;
+        Reference() : sinkId(0) {}
+        ~Reference() {
+            if (buffer.get()) buffer->closed.store(true, std::memory_order_release);
+        }
+    };
+    static thread_local Reference local;
+    if (local.sinkId != id) {
+        if (local.buffer.get()) local.buffer->closed.store(true, std::memory_order_release);
+        local.buffer = std::make_shared<Buffer>(bufferSize);
+        local.sinkId = id;
+        boost::mutex::scoped_lock lock(buffersMutex);
+        buffers.push_back(local.buffer);
+    }
+    return *local.buffer;
+}
+
+
+void AsyncLogSink::append(const std::string & category, int priority, std::string && message) {
+    ++appending;
+    if (stopping.load()) {
+        ++dropped;
+        --appending;
+        return;
+    }
+    Buffer & buffer = getLocalBuffer();
+    Buffer::Record r;
+    r.when = Time::getCurrentTime();
+    r.category = &category;
+    r.priority = priority;
+    r.message = std::move(message);
+    if (!buffer.tryPush(r)) {
+        bool pushed = false;
+        if (policy == BLOCK) {
+            // The background thread notifies room after draining, with roomMutex held
+            boost::mutex::scoped_lock lock(roomMutex);
+            while (!(pushed = buffer.tryPush(r)) && !stopping.load()) {
+                wake.notify_one();
+                room.wait(lock);
+            }
+        }
+        if (!pushed) {
+            ++dropped;
+            --appending;
+            return;
+        }
+    }
+    // Do not wait for the period if the buffer is filling up
+    if (buffer.halfFull()) wake.notify_one();
+    --appending;
+}
+
+
+void AsyncLogSink::stop() {
+    if (!writer.joinable()) return;
+    stopping.store(true);
+    {
+        boost::mutex::scoped_lock lock(roomMutex);
+        room.notify_all();
+    }
+    // Let the threads that are appending a record finish
+    while (appending.load() > 0)
+        boost::this_thread::yield();
+    {
+        boost::mutex::scoped_lock lock(wakeMutex);
+        finished.store(true);
+        wake.notify_one();
+    }
+    writer.join();
+}
+
+
+void AsyncLogSink::run() {
+    while (!finished.load()) {
+        {
+            boost::mutex::scoped_lock lock(wakeMutex);
+            if (!finished.load())
+                wake.timed_wait(lock, boost::posix_time::microseconds(flushPeriod.microseconds()));
+        }
+        drain();
+    }
+    drain();
+}
+
+
+void AsyncLogSink::drain() {
+    std::vector<std::shared_ptr<Buffer> > current;
+    {
+        boost::mutex::scoped_lock lock(buffersMutex);
+        // Forget the buffers of the threads that have exited, once they are empty
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const std::shared_ptr<Buffer> & b) {
+            return b->closed.load(std::memory_order_acquire) && b->empty();
+        }), buffers.end());
+        current = buffers;
+    }
+    std::vector<Buffer::Record> records;
+    for (auto & b : current)
+        b->popAll(records);
+    if (policy == BLOCK && !records.empty()) {
+        boost::mutex::scoped_lock lock(roomMutex);
+        room.notify_all();
+    }
+
+    unsigned long int d = dropped.load(std::memory_order_relaxed);
+    if (records.empty() && d == reportedDropped) return;
+    // Records of different threads are interleaved by time
+    std::stable_sort(records.begin(), records.end());
+    std::ostringstream batch;
+    for (auto & r : records)
+        batch << r.when << ' ' << log4cpp::Priority::getPriorityName(r.priority) << ' ' << *r.category
+                << " : " << r.message << '\n';
+    if (d != reportedDropped) {
+        batch << Time::getCurrentTime() << " WARN AsyncLogSink : " << d - reportedDropped << " records dropped\n";
+        reportedDropped = d;
+    }
+    file << batch.str();
+    file.flush();
+}
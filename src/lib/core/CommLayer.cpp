@@ -19,6 +19,7 @@
  */
 
 #include <signal.h>
+#include <map>
 #include "Logger.hpp"
 #include "Time.hpp"
 #include "ConfigurationManager.hpp"
@@ -26,7 +27,118 @@
 using boost::mutex;
 
 
-int CommLayer::Timer::timerId = 0;
+/**
+ * Routes of each message type to the services that handle it. It only depends on the handler
+ * tables of the services, in order, so it is shared among all the CommLayer objects with the
+ * same kind of services, like the nodes of a simulation.
+ */
+class CommLayer::RoutingTable {
+public:
+    typedef std::vector<const Service::HandlerTable *> Signature;
+
+    /// A service that handles a message type
+    struct Route {
+        unsigned int service;       ///< Position of the service in the list
+        Service::Handler handler;   ///< The handler, or NULL to call receiveMessage
+        Route(unsigned int s, Service::Handler h) : service(s), handler(h) {}
+    };
+
+    /**
+     * Returns the table for a certain list of services, building it only the first time.
+     */
+    static std::shared_ptr<const RoutingTable> get(const std::vector<Service *> & services);
+
+    /**
+     * Returns the routes of a message type, or NULL if they are unknown and the message must be offered
+     * to every service.
+     */
+    const std::vector<Route> * getRoutes(unsigned int type) const {
+        return type < known.size() && known[type] ? &routes[type] : NULL;
+    }
+
+private:
+    explicit RoutingTable(const Signature & tables);
+
+    std::vector<std::vector<Route> > routes;   ///< Routes of each type
+    std::vector<bool> known;                   ///< Whether the routes of each type are known
+};
+
+
+CommLayer::RoutingTable::RoutingTable(const Signature & tables) {
+    unsigned int numTypes = BasicMsg::getNumRegisteredTypes();
+    bool anyFamily = false;
+    for (unsigned int s = 0; s < tables.size(); ++s)
+        if (tables[s]) {
+            anyFamily |= tables[s]->hasFamilies();
+            for (unsigned int i = 0; i < tables[s]->size(); ++i)
+                if (tables[s]->getType(i) >= numTypes) numTypes = tables[s]->getType(i) + 1;
+        }
+    routes.resize(numTypes);
+    known.resize(numTypes, false);
+
+    // Registered classes, possibly part of a family
+    for (unsigned int type = 0; type < numTypes; ++type) {
+        std::unique_ptr<BasicMsg> prototype(BasicMsg::createMessage(type));
+        if (prototype.get()) {
+            known[type] = true;
+            for (unsigned int s = 0; s < tables.size(); ++s) {
+                Service::Handler h = tables[s] ? tables[s]->find(*prototype) : NULL;
+                if (h || !tables[s]) routes[type].push_back(Route(s, h));
+            }
+        }
+    }
+
+    // Unregistered classes explicitly handled by a service; they cannot be checked against
+    // families, so they are only known when there are none
+    if (!anyFamily) {
+        for (unsigned int type = 0; type < numTypes; ++type)
+            if (!known[type])
+                for (unsigned int s = 0; s < tables.size(); ++s)
+                    if (tables[s])
+                        for (unsigned int i = 0; i < tables[s]->size(); ++i)
+                            if (tables[s]->getType(i) == type) known[type] = true;
+        for (unsigned int type = 0; type < numTypes; ++type)
+            if (known[type] && routes[type].empty())
+                for (unsigned int s = 0; s < tables.size(); ++s) {
+                    Service::Handler h = NULL;
+                    if (tables[s]) {
+                        for (unsigned int i = 0; i < tables[s]->size() && !h; ++i)
+                            if (tables[s]->getType(i) == type) h = tables[s]->getHandler(i);
+                    }
+                    if (h || !tables[s]) routes[type].push_back(Route(s, h));
+                }
+    }
+}
+
+
+std::shared_ptr<const CommLayer::RoutingTable> CommLayer::RoutingTable::get(const std::vector<Service *> & services) {
+    static boost::mutex cacheMutex;
+    static std::map<Signature, std::shared_ptr<const RoutingTable> > cache;
+    Signature signature;
+    for (std::vector<Service *>::const_iterator it = services.begin(); it != services.end(); ++it)
+        signature.push_back((*it)->getHandlers());
+    mutex::scoped_lock lock(cacheMutex);
+    std::shared_ptr<const RoutingTable> & result = cache[signature];
+    if (!result.get())
+        result.reset(new RoutingTable(signature));
+    return result;
+}
+
+
+Service::Handler Service::HandlerTable::find(const BasicMsg & msg) const {
+    unsigned int type = msg.getTypeIndex();
+    for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        if (it->type == type || (it->matches && it->matches(msg)))
+            return it->handler;
+    return NULL;
+}
+
+
+bool Service::HandlerTable::hasFamilies() const {
+    for (std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+        if (it->matches) return true;
+    return false;
+}
 
 
 static void intTrap(int) {
@@ -34,7 +146,8 @@ static void intTrap(int) {
 }
 
 
-CommLayer::CommLayer() : nm(new NetworkManager), exitSignaled(false) {
+CommLayer::CommLayer() : nm(new NetworkManager), messageQueue(defaultQueueCapacity), exitSignaled(false),
+        measuring(false), statsPeriod(0), nextSnapshot(0) {
     localAddress = nm->getLocalAddress();
     Logger::msg("Comm", DEBUG, "Local address is ", localAddress);
     signal(SIGINT, intTrap);
@@ -48,33 +161,58 @@ CommLayer & CommLayer::getInstance() {
 
 
 void CommLayer::stopEventLoop() {
-    {
-        mutex::scoped_lock lock(queueMutex);
-        exitSignaled = true;
-    }
-    nonEmptyQueue.notify_all();
+    exitSignaled = true;
+    messageQueue.wakeConsumer();
 }
 
 
 void CommLayer::processNextMessage() {
-    CommAddress src;
-    std::shared_ptr<BasicMsg> msg;
-    {
-        mutex::scoped_lock lock(queueMutex);
-        // Wait until there are messages in the queue
-        if (messageQueue.empty()) nonEmptyQueue.wait(lock);
-        if (exitSignaled) return;
-        src = messageQueue.front().first;
-        msg = messageQueue.front().second;
-        messageQueue.pop_front();
+    QueuedMsg next;
+    // Wait until there are messages in the queue
+    if (messageQueue.pop(next, exitSignaled)) {
+        if (stats.get()) {
+            if (next.arrival) stats->addQueueDelay(*next.msg, CommStatistics::now() - next.arrival);
+            handleMessage(next.src, next.msg);
+            checkStatisticsSnapshot();
+        } else
+            handleMessage(next.src, next.msg);
     }
+}
+
 
+void CommLayer::handleMessage(const CommAddress & src, const std::shared_ptr<BasicMsg> & msg) {
     // Look for all the registered components
     bool isHandled = false;
     Logger::msg("Comm", DEBUG, "Processing message ", *msg);
-    for (std::vector<Service *>::iterator it = services.begin(); it != services.end(); it++) {
-        isHandled |= (*it)->receiveMessage(src, *msg);
+    const std::vector<RoutingTable::Route> * r = routes.get() ? routes->getRoutes(msg->getTypeIndex()) : NULL;
+    // Each service is timed from the end of the previous one, so that a message needs one clock read per service
+    CommStatistics * st = stats.get();
+    uint64_t start = st ? CommStatistics::now() : 0, last = start;
+    if (r) {
+        for (std::vector<RoutingTable::Route>::const_iterator it = r->begin(); it != r->end(); ++it) {
+            if (it->handler) {
+                it->handler(*services[it->service], src, *msg);
+                isHandled = true;
+            } else
+                isHandled |= services[it->service]->receiveMessage(src, *msg);
+            if (st) {
+                uint64_t end = CommStatistics::now();
+                st->addServiceTime(it->service, end - last);
+                last = end;
+            }
+        }
+    } else {
+        // Unknown message type, offer it to every service
+        for (unsigned int s = 0; s < services.size(); ++s) {
+            isHandled |= services[s]->receiveMessage(src, *msg);
+            if (st) {
+                uint64_t end = CommStatistics::now();
+                st->addServiceTime(s, end - last);
+                last = end;
+            }
+        }
     }
+    if (st) st->addHandlerTime(*msg, last - start);
 
     if (!isHandled && src != localAddress) {
         // It's not critical to receive a message with no handler
@@ -83,12 +221,50 @@ void CommLayer::processNextMessage() {
 }
 
 
+void CommLayer::updateRoutes() {
+    routes = RoutingTable::get(services);
+    if (stats.get()) stats->setServices(services);
+}
+
+
 void CommLayer::enqueueMessage(const CommAddress & src, const std::shared_ptr<BasicMsg> & msg) {
-    {
-        mutex::scoped_lock lock(queueMutex);
-        messageQueue.push_back(AddrMsg(src, msg));
+    QueuedMsg item(src, msg, measuring.load(std::memory_order_relaxed) ? CommStatistics::now() : 0);
+    // The item is only moved when it fits. Otherwise, it goes to the overflow list, so that
+    // neither the event loop sending to itself nor checkExpired() under timerMutex ever wait
+    if (!messageQueue.tryPush(std::move(item))) {
+        Logger::msg("Comm", DEBUG, "Message queue full, using the overflow list");
+        messageQueue.push(std::move(item));
+    }
+}
+
+
+void CommLayer::enableStatistics(const std::string & file, Duration period) {
+    stats.reset(new CommStatistics);
+    stats->setServices(services);
+    statsFile = file;
+    statsPeriod = period.microseconds() * 1000;
+    nextSnapshot = CommStatistics::now() + statsPeriod;
+    measuring = true;
+}
+
+
+void CommLayer::disableStatistics() {
+    measuring = false;
+    if (stats.get() && !statsFile.empty() && !stats->write(statsFile))
+        Logger::msg("Comm", WARN, "Cannot write message statistics to ", statsFile);
+    stats.reset();
+}
+
+
+void CommLayer::checkStatisticsSnapshot() {
+    if (stats.get() && !statsFile.empty()) {
+        uint64_t now = CommStatistics::now();
+        if (now >= nextSnapshot) {
+            if (!stats->write(statsFile))
+                Logger::msg("Comm", WARN, "Cannot write message statistics to ", statsFile);
+            nextSnapshot = now + statsPeriod;
+        }
     }
-    nonEmptyQueue.notify_all();
 }
 
 
@@ -108,9 +284,10 @@ int CommLayer::setTimerImpl(Time time, std::shared_ptr<BasicMsg> msg) {
     Timer t(time, msg);
     {
         mutex::scoped_lock lock(timerMutex);
-        timerList.push_front(t);
-        timerList.sort();
-        nm->setAsyncTimer(timerList.front().timeout);
+        timers.push(t);
+        // Only reprogram the deadline when this timer becomes the first one
+        if (timers.top().id == t.id)
+            nm->setAsyncTimer(time);
     }
     return t.id;
 }
@@ -118,27 +295,21 @@ int CommLayer::setTimerImpl(Time time, std::shared_ptr<BasicMsg> msg) {
 
 void CommLayer::cancelTimer(int timerId) {
     mutex::scoped_lock lock(timerMutex);
-    // Erase timer in hashmap and list
-    for (std::list<Timer>::iterator it = timerList.begin(); it != timerList.end(); it++) {
-        if (it->id == timerId) {
-            Logger::msg("Time", DEBUG, "Erasing timer with id ", timerId);
-            timerList.erase(it);
-            break;
-        }
-    }
+    if (timers.cancel(timerId))
+        Logger::msg("Time", DEBUG, "Erasing timer with id ", timerId);
 }
 
 
 void CommLayer::checkExpired() {
     Time ct = Time::getCurrentTime();
     mutex::scoped_lock lock(timerMutex);
-    while (!timerList.empty()) {
-        if (timerList.front().timeout <= ct) {
-            enqueueMessage(localAddress, timerList.front().msg);
-            timerList.pop_front();
+    while (!timers.empty()) {
+        if (timers.top().timeout <= ct) {
+            enqueueMessage(localAddress, timers.top().msg);
+            timers.pop();
         } else {
             // Program next timer
-            nm->setAsyncTimer(timerList.front().timeout);
+            nm->setAsyncTimer(timers.top().timeout);
             break;
         }
     }
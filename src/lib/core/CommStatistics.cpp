@@ -0,0 +1,114 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <typeinfo>
+#include <boost/core/demangle.hpp>
+#include "CommStatistics.hpp"
+#include "CommLayer.hpp"
+
+
+void LatencyHistogram::clear() {
+    std::fill(buckets, buckets + numBuckets, 0);
+    count = sum = max = 0;
+}
+
+
+uint64_t LatencyHistogram::getPercentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = p * count, seen = 0;
+    if (rank >= count) rank = count - 1;
+    for (unsigned int b = 0; b < numBuckets; ++b) {
+        seen += buckets[b];
+        if (seen > rank) return std::min(upperBound(b), max);
+    }
+    return max;
+}
+
+
+CommStatistics::ServiceStats::ServiceStats(const Service * s) : service(s), name(boost::core::demangle(typeid(*s).name())) {}
+
+
+void CommStatistics::setServices(const std::vector<Service *> & services) {
+    std::vector<unsigned int> next(services.size());
+    for (unsigned int i = 0; i < services.size(); ++i) {
+        unsigned int j = 0;
+        while (j < serviceStats.size() && serviceStats[j]->service != services[i]) ++j;
+        if (j == serviceStats.size())
+            serviceStats.push_back(std::unique_ptr<ServiceStats>(new ServiceStats(services[i])));
+        next[i] = j;
+    }
+    // Forget the services that left, their address may be reused
+    for (unsigned int j = 0; j < serviceStats.size(); ++j)
+        if (std::find(next.begin(), next.end(), j) == next.end())
+            serviceStats[j]->service = NULL;
+    current.swap(next);
+}
+
+
+void CommStatistics::clear() {
+    for (std::vector<std::unique_ptr<TypeStats> >::iterator it = typeStats.begin(); it != typeStats.end(); ++it)
+        if (it->get()) {
+            (*it)->queueDelay.clear();
+            (*it)->handlerTime.clear();
+        }
+    for (std::vector<std::unique_ptr<ServiceStats> >::iterator it = serviceStats.begin(); it != serviceStats.end(); ++it)
+        (*it)->handlerTime.clear();
+}
+
+
+static void outputTimes(std::ostream & os, const LatencyHistogram & h) {
+    double mean = h.getCount() ? (double)h.getSum() / h.getCount() : 0.0;
+    os << ',' << mean / 1000.0 << ',' << h.getPercentile(0.5) / 1000.0 << ',' << h.getPercentile(0.99) / 1000.0
+            << ',' << h.getMax() / 1000.0;
+}
+
+
+void CommStatistics::output(std::ostream & os) const {
+    os << "# type,count,queue_mean_us,queue_p50_us,queue_p99_us,queue_max_us,"
+            "handler_mean_us,handler_p50_us,handler_p99_us,handler_max_us" << std::endl;
+    for (std::vector<std::unique_ptr<TypeStats> >::const_iterator it = typeStats.begin(); it != typeStats.end(); ++it)
+        if (it->get()) {
+            os << (*it)->name << ',' << (*it)->handlerTime.getCount();
+            outputTimes(os, (*it)->queueDelay);
+            outputTimes(os, (*it)->handlerTime);
+            os << std::endl;
+        }
+    os << "# service,count,handler_mean_us,handler_p50_us,handler_p99_us,handler_max_us" << std::endl;
+    for (std::vector<std::unique_ptr<ServiceStats> >::const_iterator it = serviceStats.begin(); it != serviceStats.end(); ++it) {
+        os << (*it)->name << ((*it)->service ? "" : " (unregistered)") << ',' << (*it)->handlerTime.getCount();
+        outputTimes(os, (*it)->handlerTime);
+        os << std::endl;
+    }
+}
+
+
+bool CommStatistics::write(const std::string & file) const {
+    // Write a new file and replace the old one, so that readers never see half a snapshot
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream ofs(tmp.c_str());
+        output(ofs);
+        if (!ofs) return false;
+    }
+    return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
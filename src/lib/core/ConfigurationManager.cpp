@@ -46,16 +46,27 @@ ConfigurationManager::ConfigurationManager() : description("Allowed options") {
 #else
     logString = "root=WARN";
 #endif
+    logBuffer = 4096;
+    logBlock = false;
     submitRetries = 3;
     heartbeat = 60;
     availMemory = 128;
     availDisk = 200;
     dbPath = workingPath / boost::filesystem::path("stars.db");
     requestTimeout = 30.0;
+    linkIdleTimeout = 30.0;
+    sendQueueLimit = 1048576;
+    ioThreads = 1;
+    commStatsPeriod = 60.0;
+    incrementalReductions = 16;
+    deltaUpdates = 8;
 
     // Options description
     description.add_options()
     ("log,l", value<string>(&logString), "logging configuration")
+    ("log_file", value<string>(&logFile), "write the log to this file from a background thread")
+    ("log_buffer", value<unsigned int>(&logBuffer), "log records that each thread can have pending")
+    ("log_block", bool_switch(&logBlock), "wait for room in a full log buffer instead of dropping records")
     ("port,p", value<uint16_t>(&port), "port for peer communication")
     ("ui_port", value<uint16_t>(&uiPort), "port for UI")
     ("mem,m", value<unsigned int>(&availMemory), "available memory for tasks")
@@ -63,6 +74,13 @@ ConfigurationManager::ConfigurationManager() : description("Allowed options") {
     ("update_bw,u", value<double>(&updateBW), "update bandwidth limit")
     ("retries,r", value<int>(&submitRetries), "automatic submission retries")
     ("heartbeat,h", value<int>(&heartbeat), "task heartbeat period")
+    ("link_idle_timeout", value<double>(&linkIdleTimeout), "seconds before an unused connection is closed")
+    ("send_queue_limit", value<unsigned int>(&sendQueueLimit), "bytes queued for a destination before availability updates to it are delayed")
+    ("io_threads", value<unsigned int>(&ioThreads), "threads that receive and unpack messages")
+    ("comm_stats_file", value<string>(&commStatsFile), "write message handling statistics to this file")
+    ("comm_stats_period", value<double>(&commStatsPeriod), "seconds between message handling statistics snapshots")
+    ("incremental_reductions", value<unsigned int>(&incrementalReductions), "incremental reductions of the information before one from scratch")
+    ("delta_updates", value<unsigned int>(&deltaUpdates), "availability updates sent as changes before a whole one")
     ;
 }
 
@@ -18,9 +18,14 @@
  *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <map>
+#include <memory>
+#include <sstream>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
 #include <log4cpp/Category.hh>
 #include "Logger.hpp"
+#include "AsyncLogSink.hpp"
 
 
 namespace {
@@ -31,6 +36,41 @@ struct fix2hourdigits {
         boost::posix_time::time_facet::default_time_duration_format = format;
     }
 } fix2hourdigits_var;
+
+
+/// Handles of the categories used so far, by name
+struct HandleRegistry {
+    boost::mutex mutex;
+    std::map<std::string, std::unique_ptr<Logger::Handle> > handles;
+
+    static HandleRegistry & getInstance() {
+        static HandleRegistry instance;
+        return instance;
+    }
+};
+
+
+/// The stream where a thread writes its messages, reused from one message to the next
+struct ThreadStream {
+    std::ostringstream stream;
+    log4cpp::Category * category;
+    int priority;
+    bool inUse;   ///< Set while a message is being written, in case writing a value logs another message
+
+    ThreadStream() : category(NULL), priority(0), inUse(false) {}
+
+    static ThreadStream & getInstance() {
+        static thread_local ThreadStream instance;
+        return instance;
+    }
+};
+
+
+/// A stream for a message written while the thread stream is in use
+struct NestedStream : public std::ostringstream {
+    log4cpp::Category * category;
+    int priority;
+};
 }
 
 
@@ -54,15 +94,66 @@ void Logger::setPriority(const std::string & catPrio) {
 }
 
 
+const Logger::Handle & Logger::findHandle(const char * category) {
+    HandleRegistry & registry = HandleRegistry::getInstance();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    std::unique_ptr<Handle> & h = registry.handles[category];
+    if (!h.get()) {
+        h.reset(new Handle);
+        h->category = &log4cpp::Category::getInstance(category);
+        h->priority.store(h->category->getChainedPriority(), std::memory_order_relaxed);
+    }
+    return *h;
+}
+
+
+void Logger::updatePriorities() {
+    // Priorities are inherited, so any change may affect every category
+    HandleRegistry & registry = HandleRegistry::getInstance();
+    boost::mutex::scoped_lock lock(registry.mutex);
+    for (auto & i : registry.handles)
+        i.second->priority.store(i.second->category->getChainedPriority(), std::memory_order_relaxed);
+}
+
+
 std::ostream * Logger::streamIfEnabled(const char * category, int priority) {
-    log4cpp::Category & cat = log4cpp::Category::getInstance(category);
-    if (cat.isPriorityEnabled(priority))
-        return nullptr; // TODO
-    else
+    log4cpp::Category * cat = getHandle(category).category;
+    if (!cat->isPriorityEnabled(priority))
         return nullptr;
+    ThreadStream & ts = ThreadStream::getInstance();
+    if (ts.inUse) {
+        NestedStream * out = new NestedStream;
+        out->category = cat;
+        out->priority = priority;
+        return out;
+    }
+    ts.inUse = true;
+    ts.category = cat;
+    ts.priority = priority;
+    ts.stream.str(std::string());
+    ts.stream.clear();
+    return &ts.stream;
 }
 
 
-void Logger::freeStream(std::ostream * out) {
+void Logger::sendMessage(log4cpp::Category * category, int priority, std::string message) {
+    // Remove the line end that msg appends
+    if (!message.empty() && message[message.size() - 1] == '\n')
+        message.erase(message.size() - 1);
+    AsyncLogSink * s = sink().load();
+    if (s) s->append(category->getName(), priority, std::move(message));
+    else category->log(priority, message);
+}
 
+
+void Logger::freeStream(std::ostream * out) {
+    ThreadStream & ts = ThreadStream::getInstance();
+    if (out == &ts.stream) {
+        sendMessage(ts.category, ts.priority, ts.stream.str());
+        ts.inUse = false;
+    } else if (NestedStream * nested = dynamic_cast<NestedStream *>(out)) {
+        sendMessage(nested->category, nested->priority, nested->str());
+        delete nested;
+    }
+    // Otherwise, it is a stream that does not belong to this backend
 }
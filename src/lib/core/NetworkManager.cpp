@@ -18,6 +18,10 @@
  *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <boost/thread/thread_time.hpp>
 #include <msgpack.hpp>
 #include "NetworkManager.hpp"
 #include "CommLayer.hpp"
@@ -47,23 +51,78 @@ void NetworkManager::listen() {
     acceptor.listen(net::socket_base::max_connections, ec);
     acceptor.async_accept(incoming->socket,
                           bind(&NetworkManager::handleAccept, this, net::placeholders::error));
-    t.reset(new boost::thread(bind((size_t (net::io_service:: *)())(&net::io_service::run), &io)));
-    Logger::msg("Net", INFO, "Thread ", t->get_id(), " accepting connections on port ", ConfigurationManager::getInstance().getPort());
+    unsigned int numThreads = std::max(1u, ConfigurationManager::getInstance().getIOThreads());
+    for (unsigned int i = 0; i < numThreads; ++i)
+        ioThreads.create_thread(bind(&NetworkManager::runIo, this));
+    Logger::msg("Net", INFO, numThreads, " threads accepting connections on port ", ConfigurationManager::getInstance().getPort());
+}
+
+
+void NetworkManager::runIo() {
     // The following is needed for the test cases, it does nothing in production code
-    io.dispatch(CommLayer::getInstance);
+    CommLayer::getInstance();
+    io.run();
 }
 
 
 unsigned int NetworkManager::sendMessage(const CommAddress & dst, BasicMsg * msg) {
+    if (!knowsWireIds(dst))
+        return sendLegacyMessage(dst, msg);
+
+    // Serialize the message after room for its length
+    std::shared_ptr<Frame> f(new Frame);
+    uint32_t length = 0;
+    f->data.write((const char *)&length, sizeof(length));
+    msgpack::packer<msgpack::sbuffer> pk(&f->data);
+    msg->pack(pk);
+    length = htonl(f->data.size() - sizeof(length));
+    std::memcpy(f->data.data(), &length, sizeof(length));
+    std::size_t size = f->size();
+    Logger::msg("Comm", DEBUG, "Sending ", *msg, " to ", dst);
+
+    boost::mutex::scoped_lock lock(linksMutex);
+    std::shared_ptr<Link> l = links[dst];
+    if (!l.get()) {
+        l.reset(new Link(io, dst));
+        links[dst] = l;
+        uint16_t port = acceptor.local_endpoint().port();
+        l->header[0] = linkPreamble;
+        l->header[1] = port >> 8;
+        l->header[2] = port & 0xFF;
+        l->socket.async_connect(tcp::endpoint(dst.getIP(), dst.getPort()),
+                l->strand.wrap(bind(&NetworkManager::handleLinkConnect, this, net::placeholders::error, l)));
+    }
+    // Never wait for the peer to keep up, that would stall the event loop; senders check isCongested instead
+    if (!l->congested && l->queuedBytes > 0 && l->queuedBytes + size > ConfigurationManager::getInstance().getSendQueueLimit()) {
+        Logger::msg("Comm", WARN, "Send queue to ", dst, " is over ", ConfigurationManager::getInstance().getSendQueueLimit(), " bytes");
+        l->congested = true;
+    }
+    l->pending.push_back(f);
+    l->queuedBytes += size;
+    if (l->connected && l->writing.empty())
+        startLinkWrite(l);
+    return size;
+}
+
+
+bool NetworkManager::isCongested(const CommAddress & dst) {
+    boost::mutex::scoped_lock lock(linksMutex);
+    std::map<CommAddress, std::shared_ptr<Link> >::iterator it = links.find(dst);
+    return it != links.end() && it->second->congested;
+}
+
+
+unsigned int NetworkManager::sendLegacyMessage(const CommAddress & dst, BasicMsg * msg) {
     // Serialize the message
     std::shared_ptr<Connection> c(new Connection(io));
     c->dst = dst;
-    std::ostream buffer(&c->writeBuffer);
-    msgpack::packer<std::ostream> pk(&buffer);
+    msgpack::packer<msgpack::sbuffer> pk(&c->writeBuffer);
     // Send the source port number
     uint16_t port = acceptor.local_endpoint().port();
     pk.pack(port);
-    msg->pack(pk);
+    // Old peers ignore anything after the message
+    msg->packWithName(pk);
+    pk.pack(true);
     unsigned int size = c->writeBuffer.size();
     Logger::msg("Comm", DEBUG, "Sending ", *msg, " to ", dst);
     c->socket.async_connect(tcp::endpoint(dst.getIP(), dst.getPort()),
@@ -75,7 +134,7 @@ unsigned int NetworkManager::sendMessage(const CommAddress & dst, BasicMsg * msg
 void NetworkManager::handleConnect(const boost::system::error_code & error, std::shared_ptr<Connection> c) {
     if (!error) {
         Logger::msg("Comm", DEBUG, "Connection established with ", c->dst);
-        net::async_write(c->socket, c->writeBuffer.data(),
+        net::async_write(c->socket, net::buffer(c->writeBuffer.data(), c->writeBuffer.size()),
                 bind(&NetworkManager::handleWrite, this, net::placeholders::error, c));
     } else {
         Logger::msg("Comm", WARN, "Destination unreachable: ", c->dst);
@@ -88,14 +147,118 @@ void NetworkManager::handleWrite(const boost::system::error_code & error, std::s
 }
 
 
+void NetworkManager::handleLinkConnect(const boost::system::error_code & error, std::shared_ptr<Link> l) {
+    boost::mutex::scoped_lock lock(linksMutex);
+    if (l->closed) return;
+    if (!error) {
+        Logger::msg("Comm", DEBUG, "Connection established with ", l->dst);
+        l->connected = true;
+        // The peer never writes on this connection, so a read only completes when it is closed
+        net::async_read(l->socket, net::buffer(&l->readByte, 1),
+                l->strand.wrap(bind(&NetworkManager::handleLinkRead, this, net::placeholders::error, l)));
+        startLinkWrite(l);
+    } else {
+        Logger::msg("Comm", WARN, "Destination unreachable: ", l->dst);
+        closeLink(l);
+    }
+}
+
+
+void NetworkManager::startLinkWrite(std::shared_ptr<Link> l) {
+    std::vector<net::const_buffer> buffers;
+    if (!l->handshakeSent) {
+        buffers.push_back(net::buffer(l->header, sizeof(l->header)));
+        l->handshakeSent = true;
+    }
+    // Gather all the pending frames in one write
+    for (std::deque<std::shared_ptr<Frame> >::iterator it = l->pending.begin(); it != l->pending.end(); ++it) {
+        buffers.push_back(net::buffer((*it)->data.data(), (*it)->data.size()));
+        l->writing.push_back(*it);
+    }
+    l->pending.clear();
+    if (buffers.empty()) {
+        armLinkIdleTimer(l);
+    } else {
+        ++l->idleGeneration;
+        l->idleTimer.cancel();
+        net::async_write(l->socket, buffers,
+                l->strand.wrap(bind(&NetworkManager::handleLinkWrite, this, net::placeholders::error, l)));
+    }
+}
+
+
+void NetworkManager::handleLinkWrite(const boost::system::error_code & error, std::shared_ptr<Link> l) {
+    boost::mutex::scoped_lock lock(linksMutex);
+    if (l->closed) return;
+    if (!error) {
+        for (std::vector<std::shared_ptr<Frame> >::iterator it = l->writing.begin(); it != l->writing.end(); ++it)
+            l->queuedBytes -= (*it)->size();
+        l->writing.clear();
+        if (l->congested && l->queuedBytes <= ConfigurationManager::getInstance().getSendQueueLimit()) {
+            Logger::msg("Comm", INFO, "Send queue to ", l->dst, " drained");
+            l->congested = false;
+        }
+        startLinkWrite(l);
+    } else {
+        Logger::msg("Comm", WARN, "Error sending to ", l->dst, ": ", error.message());
+        closeLink(l);
+    }
+}
+
+
+void NetworkManager::armLinkIdleTimer(std::shared_ptr<Link> l) {
+    l->idleTimer.expires_from_now(boost::posix_time::microseconds(
+            (int64_t)(ConfigurationManager::getInstance().getLinkIdleTimeout() * 1000000.0)));
+    l->idleTimer.async_wait(l->strand.wrap(
+            bind(&NetworkManager::handleLinkIdle, this, net::placeholders::error, l, ++l->idleGeneration)));
+}
+
+
+void NetworkManager::handleLinkIdle(const boost::system::error_code & error, std::shared_ptr<Link> l, unsigned int generation) {
+    if (error == net::error::operation_aborted) return;
+    boost::mutex::scoped_lock lock(linksMutex);
+    // The link may have been used after the timer expired
+    if (!l->closed && generation == l->idleGeneration && l->pending.empty() && l->writing.empty()) {
+        Logger::msg("Comm", DEBUG, "Closing idle connection with ", l->dst);
+        closeLink(l);
+    }
+}
+
+
+void NetworkManager::handleLinkRead(const boost::system::error_code & error, std::shared_ptr<Link> l) {
+    if (error == net::error::operation_aborted) return;
+    boost::mutex::scoped_lock lock(linksMutex);
+    if (!l->closed) {
+        Logger::msg("Comm", DEBUG, "Connection closed by ", l->dst);
+        closeLink(l);
+    }
+}
+
+
+void NetworkManager::closeLink(std::shared_ptr<Link> l) {
+    unsigned int dropped = l->pending.size() + l->writing.size();
+    if (dropped)
+        Logger::msg("Comm", WARN, "Dropping ", dropped, " messages to ", l->dst);
+    l->closed = true;
+    l->pending.clear();
+    l->writing.clear();
+    l->queuedBytes = 0;
+    std::map<CommAddress, std::shared_ptr<Link> >::iterator it = links.find(l->dst);
+    if (it != links.end() && it->second == l)
+        links.erase(it);
+    boost::system::error_code ec;
+    l->idleTimer.cancel(ec);
+    l->socket.shutdown(tcp::socket::shutdown_both, ec);
+    l->socket.close(ec);
+}
+
+
 void NetworkManager::handleAccept(const boost::system::error_code & error) {
     if (!error) {
         // Program an async_read for the data
         Logger::msg("Comm", DEBUG, "Connection accepted between src(", incoming->socket.remote_endpoint(),
                 ") and dst(", incoming->socket.local_endpoint(), ')');
-        net::streambuf::mutable_buffers_type bufs = incoming->readBuffer.prepare(1500);
-        net::async_read(incoming->socket, bufs, net::transfer_at_least(1),
-                        bind(&NetworkManager::handleRead, this, net::placeholders::error, net::placeholders::bytes_transferred, incoming));
+        startRead(incoming, readChunkSize);
         // Program a new async_accept
         incoming.reset(new Connection(io));
         acceptor.async_accept(incoming->socket,
@@ -104,37 +267,98 @@ void NetworkManager::handleAccept(const boost::system::error_code & error) {
 }
 
 
+void NetworkManager::startRead(std::shared_ptr<Connection> c, std::size_t bytes) {
+    c->pac.reserve_buffer(bytes);
+    // Handlers of different connections run in parallel, those of the same connection in order
+    c->socket.async_read_some(net::buffer(c->pac.buffer(), c->pac.buffer_capacity()),
+            c->strand.wrap(bind(&NetworkManager::handleRead, this, net::placeholders::error, net::placeholders::bytes_transferred, c)));
+}
+
+
 void NetworkManager::handleRead(const boost::system::error_code & error, size_t bytes_transferred, std::shared_ptr<Connection> c) {
     if (!error) {
-        // Read until EOF or end of buffer
-        c->readBuffer.commit(bytes_transferred);
-        net::streambuf::mutable_buffers_type bufs = c->readBuffer.prepare(1500);
-        net::async_read(c->socket, bufs, net::transfer_at_least(1),
-                        bind(&NetworkManager::handleRead, this, net::placeholders::error, net::placeholders::bytes_transferred, c));
-    } else if (error == net::error::eof) {
-        // Unserialize the message
-        msgpack::unpacker pac;
+        c->pac.buffer_consumed(bytes_transferred);
+        if (c->mode == Connection::UNKNOWN)
+            c->mode = (uint8_t)*c->pac.nonparsed_buffer() == linkPreamble ? Connection::FRAMED : Connection::LEGACY;
+        std::size_t next = readChunkSize;
+        if (c->mode == Connection::FRAMED) {
+            if (!readFrames(c, next)) return;
+        } else if ((c->received += bytes_transferred) > Connection::maxReadBufferSize) {
+            // Read until EOF or end of buffer
+            Logger::msg("Net", ERROR, "Message too long from ", c->socket.remote_endpoint());
+            return;
+        }
+        startRead(c, next);
+    } else if (error == net::error::eof && c->mode == Connection::LEGACY) {
+        readLegacyMessage(c);
+    }
+}
+
+
+void NetworkManager::readLegacyMessage(std::shared_ptr<Connection> c) {
+    // Unserialize the message, which is already in the unpacker
+    msgpack::unpacker & pac = c->pac;
+    try {
+        // Read source port
+        uint16_t port;
+        msgpack::unpacked msg;
+        pac.next(&msg);
+        msg.get().convert(&port);
+        CommAddress src(c->socket.remote_endpoint().address(), port);
+        // Read message
+        BasicMsg * bmsg;
+        bool withId;
+        bmsg = BasicMsg::unpackMessage(pac, &withId);
+        if (withId || pac.next(&msg)) {
+            boost::mutex::scoped_lock lock(peersMutex);
+            wireIdPeers.insert(src);
+        }
+        Logger::msg("Net", INFO, "Received message ", *bmsg, " from ", src);
+        CommLayer::getInstance().enqueueMessage(src, std::shared_ptr<BasicMsg>(bmsg));
+    } catch (...) {
+        Logger::msg("Net", ERROR, "Failed serialization of message from ", c->socket.remote_endpoint());
+    }
+}
+
+
+bool NetworkManager::readFrames(std::shared_ptr<Connection> c, std::size_t & next) {
+    // Headers are read in place, and messages are unpacked from the same buffer the socket wrote to
+    msgpack::unpacker & pac = c->pac;
+    if (!c->handshakeDone) {
+        // Preamble and source port
+        if (pac.nonparsed_size() < 3) return true;
+        const uint8_t * header = (const uint8_t *)pac.nonparsed_buffer();
+        boost::system::error_code ec;
+        c->dst = CommAddress(c->socket.remote_endpoint(ec).address(), (header[1] << 8) | header[2]);
+        pac.skip_nonparsed_buffer(3);
+        c->handshakeDone = true;
+        boost::mutex::scoped_lock lock(peersMutex);
+        wireIdPeers.insert(c->dst);
+    }
+    while (pac.nonparsed_size() >= sizeof(uint32_t)) {
+        uint32_t length;
+        std::memcpy(&length, pac.nonparsed_buffer(), sizeof(length));
+        length = ntohl(length);
+        if (length > Connection::maxReadBufferSize - sizeof(length)) {
+            Logger::msg("Net", ERROR, "Frame of ", length, " bytes from ", c->dst, " is too long, closing connection");
+            return false;
+        }
+        if (pac.nonparsed_size() < sizeof(length) + length) {
+            // Make room for the rest of the frame in one go
+            next = std::max(next, sizeof(length) + length - pac.nonparsed_size());
+            break;
+        }
+        pac.skip_nonparsed_buffer(sizeof(length));
         try {
-            // feeds the buffer.
-            size_t bytes = c->readBuffer.size();
-            pac.reserve_buffer(bytes);
-            c->readBuffer.sgetn(pac.buffer(), bytes);
-            pac.buffer_consumed(bytes);
-            // Read source port
-            uint16_t port;
-            msgpack::unpacked msg;
-            pac.next(&msg);
-            msg.get().convert(&port);
-            CommAddress src(c->socket.remote_endpoint().address(), port);
-            // Read message
-            BasicMsg * bmsg;
-            bmsg = BasicMsg::unpackMessage(pac);
-            Logger::msg("Net", INFO, "Received message ", *bmsg, " from ", src);
-            CommLayer::getInstance().enqueueMessage(src, std::shared_ptr<BasicMsg>(bmsg));
+            BasicMsg * bmsg = BasicMsg::unpackMessage(pac);
+            Logger::msg("Net", INFO, "Received message ", *bmsg, " from ", c->dst);
+            CommLayer::getInstance().enqueueMessage(c->dst, std::shared_ptr<BasicMsg>(bmsg));
         } catch (...) {
-            Logger::msg("Net", ERROR, "Failed serialization of message from ", c->socket.remote_endpoint());
+            Logger::msg("Net", ERROR, "Failed serialization of message from ", c->dst, ", closing connection");
+            return false;
         }
     }
+    return true;
 }
 
 
@@ -152,6 +376,13 @@ CommAddress NetworkManager::getLocalAddress() const {
 
 
 void NetworkManager::setAsyncTimer(Time timeout) {
+    // Changing the expiration time cancels the previous wait, so there is only one deadline armed
     timer.expires_at(timeout.to_posix_time());
-    timer.async_wait(bind(&CommLayer::checkExpired, &CommLayer::getInstance()));
+    timer.async_wait(bind(&NetworkManager::handleTimer, this, net::placeholders::error));
+}
+
+
+void NetworkManager::handleTimer(const boost::system::error_code & error) {
+    if (error != net::error::operation_aborted)
+        CommLayer::getInstance().checkExpired();
 }
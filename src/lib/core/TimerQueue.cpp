@@ -0,0 +1,82 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "TimerQueue.hpp"
+
+
+int TimerQueue::Timer::timerId = 0;
+
+
+void TimerQueue::push(const Timer & t) {
+    heap.push_back(t);
+    position[t.id] = heap.size() - 1;
+    siftUp(heap.size() - 1);
+}
+
+
+bool TimerQueue::cancel(int id) {
+    std::unordered_map<int, size_t>::iterator it = position.find(id);
+    if (it == position.end()) return false;
+    removeAt(it->second);
+    return true;
+}
+
+
+void TimerQueue::removeAt(size_t i) {
+    position.erase(heap[i].id);
+    if (i + 1 < heap.size()) {
+        Timer last = heap.back();
+        heap.pop_back();
+        place(i, last);
+        // The last element may need to go either way
+        if (i > 0 && before(heap[i], heap[(i - 1) / arity])) siftUp(i);
+        else siftDown(i);
+    } else heap.pop_back();
+}
+
+
+void TimerQueue::siftUp(size_t i) {
+    Timer t = heap[i];
+    while (i > 0) {
+        size_t parent = (i - 1) / arity;
+        if (!before(t, heap[parent])) break;
+        place(i, heap[parent]);
+        i = parent;
+    }
+    place(i, t);
+}
+
+
+void TimerQueue::siftDown(size_t i) {
+    Timer t = heap[i];
+    size_t n = heap.size();
+    for (;;) {
+        size_t first = i * arity + 1;
+        if (first >= n) break;
+        size_t best = first, last = std::min(first + arity, n);
+        for (size_t c = first + 1; c < last; ++c)
+            if (before(heap[c], heap[best])) best = c;
+        if (!before(heap[best], t)) break;
+        place(i, heap[best]);
+        i = best;
+    }
+    place(i, t);
+}
@@ -21,6 +21,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <memory>
 #include <boost/filesystem/fstream.hpp>
 #include <stdexcept>
 #include <log4cpp/Priority.hh>
@@ -30,6 +31,7 @@
 #include <log4cpp/FileAppender.hh>
 #include "ConfigurationManager.hpp"
 #include "Logger.hpp"
+#include "AsyncLogSink.hpp"
 #include "StructureNode.hpp"
 #include "ResourceNode.hpp"
 #include "SubmissionNode.hpp"
@@ -103,6 +105,27 @@ Appender * addFileLogging(fs::path logFile, bool append, Layout * layout) {
 }
 
 
+/**
+ * Stops the asynchronous log sink when main exits, also when it throws. The network threads,
+ * if they were started, are stopped first, so that no thread is logging when the sink is unset,
+ * flushed and freed.
+ */
+struct LogSinkGuard {
+    AsyncLogSink * sink;
+    bool networkStarted;
+    LogSinkGuard() : sink(NULL), networkStarted(false) {}
+    ~LogSinkGuard() {
+        if (networkStarted)
+            CommLayer::getInstance().stopNetwork();
+        Logger::setSink(NULL);
+        if (sink) {
+            sink->stop();
+            delete sink;
+        }
+    }
+};
+
+
 int main(int argc, char * argv[]) {
     try {
         // Configure
@@ -116,8 +139,21 @@ int main(int argc, char * argv[]) {
         // Start logging
         Logger::initLog(ConfigurationManager::getInstance().getLogConfig());
         addConsoleLogging(NULL);
+        LogSinkGuard logSink;
+        if (!ConfigurationManager::getInstance().getLogFile().empty()) {
+            logSink.sink = new AsyncLogSink(ConfigurationManager::getInstance().getLogFile(),
+                    ConfigurationManager::getInstance().getLogBuffer(),
+                    ConfigurationManager::getInstance().getLogBlock() ? AsyncLogSink::BLOCK : AsyncLogSink::DROP);
+            Logger::setSink(logSink.sink);
+        }
+        if (!ConfigurationManager::getInstance().getCommStatsFile().empty())
+            CommLayer::getInstance().enableStatistics(ConfigurationManager::getInstance().getCommStatsFile(),
+                    Duration(ConfigurationManager::getInstance().getCommStatsPeriod()));
         // Start io thread and listen to incoming connections
-        CommLayer::getInstance().listen();
+        CommLayer & comm = CommLayer::getInstance();
+        // Even if listen fails, some threads may be running already
+        logSink.networkStarted = true;
+        comm.listen();
         // Get local address
         // Init CommLayer and standard services
         Logger::msg("", DEBUG, "Creating standard services");
@@ -135,6 +171,8 @@ int main(int argc, char * argv[]) {
         // Start event handling
         CommLayer::getInstance().commEventLoop();
         Logger::msg("", DEBUG, "Gracely exiting");
+        CommLayer::getInstance().disableStatistics();
+        // logSink stops the network threads and writes the pending log records on return
         return 0;
     } catch (std::exception & e) {
         std::cerr << "Exception caught: " << e.what() << std::endl;
@@ -295,14 +295,15 @@ void ResourceNode::handleDelayedMsgs() {
 }
 
 
-#define HANDLE_MESSAGE(x) if (typeid(msg) == typeid(x)) { handle(src, static_cast<const x &>(msg)); return true; }
-bool ResourceNode::receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-    HANDLE_MESSAGE(NewFatherMsg)
-    HANDLE_MESSAGE(AckMsg);
-    HANDLE_MESSAGE(NackMsg);
-    HANDLE_MESSAGE(CommitMsg);
-    HANDLE_MESSAGE(RollbackMsg);
-    HANDLE_MESSAGE(InsertMsg);
-    HANDLE_MESSAGE(InsertCommandMsg);
-    return false;
+#define HANDLE_MESSAGE(x) .add<x>(SERVICE_HANDLER(ResourceNode, x))
+const Service::HandlerTable * ResourceNode::getHandlers() const {
+    static const HandlerTable handlers = HandlerTable()
+        HANDLE_MESSAGE(NewFatherMsg)
+        HANDLE_MESSAGE(AckMsg)
+        HANDLE_MESSAGE(NackMsg)
+        HANDLE_MESSAGE(CommitMsg)
+        HANDLE_MESSAGE(RollbackMsg)
+        HANDLE_MESSAGE(InsertMsg)
+        HANDLE_MESSAGE(InsertCommandMsg);
+    return &handlers;
 }
@@ -1023,18 +1023,19 @@ void StructureNode::handleDelayedMsgs() {
 }
 
 
-#define HANDLE_MESSAGE(x) if (typeid(msg) == typeid(x)) { handle(src, static_cast<const x &>(msg)); return true; }
-bool StructureNode::receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-    HANDLE_MESSAGE(InitStructNodeMsg);
-    HANDLE_MESSAGE(UpdateZoneMsg);
-    HANDLE_MESSAGE(InsertMsg);
-    HANDLE_MESSAGE(StrNodeNeededMsg);
-    HANDLE_MESSAGE(NewStrNodeMsg);
-    HANDLE_MESSAGE(NewFatherMsg);
-    HANDLE_MESSAGE(NewChildMsg);
-    HANDLE_MESSAGE(AckMsg);
-    HANDLE_MESSAGE(CommitMsg);
-    HANDLE_MESSAGE(NackMsg);
-    HANDLE_MESSAGE(RollbackMsg);
-    return false;
+#define HANDLE_MESSAGE(x) .add<x>(SERVICE_HANDLER(StructureNode, x))
+const Service::HandlerTable * StructureNode::getHandlers() const {
+    static const HandlerTable handlers = HandlerTable()
+        HANDLE_MESSAGE(InitStructNodeMsg)
+        HANDLE_MESSAGE(UpdateZoneMsg)
+        HANDLE_MESSAGE(InsertMsg)
+        HANDLE_MESSAGE(StrNodeNeededMsg)
+        HANDLE_MESSAGE(NewStrNodeMsg)
+        HANDLE_MESSAGE(NewFatherMsg)
+        HANDLE_MESSAGE(NewChildMsg)
+        HANDLE_MESSAGE(AckMsg)
+        HANDLE_MESSAGE(CommitMsg)
+        HANDLE_MESSAGE(NackMsg)
+        HANDLE_MESSAGE(RollbackMsg);
+    return &handlers;
 }
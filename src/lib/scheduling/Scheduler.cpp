@@ -49,6 +49,7 @@ public:
 
     EMPTY_MSGPACK_DEFINE();
 };
+REGISTER_MESSAGE(MonitorTimer);
 static std::shared_ptr<MonitorTimer> monTmr(new MonitorTimer);
 static std::shared_ptr<RescheduleTimer> reschTmr(new RescheduleTimer);
 
@@ -216,14 +217,15 @@ template<> void Scheduler::handle(const CommAddress & src, const MonitorTimer &
 }
 
 
-#define HANDLE_MESSAGE(x) if (typeid(msg) == typeid(x)) { handle(src, static_cast<const x &>(msg)); return true; }
-bool Scheduler::receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-    if (dynamic_cast<const TaskBagMsg *>(&msg)) { handle(src, static_cast<const TaskBagMsg &>(msg)); return true; }
-    HANDLE_MESSAGE(TaskStateChgMsg)
-    HANDLE_MESSAGE(RescheduleTimer)
-    HANDLE_MESSAGE(AbortTaskMsg)
-    HANDLE_MESSAGE(MonitorTimer)
-    return false;
+#define HANDLE_MESSAGE(x) .add<x>(SERVICE_HANDLER(Scheduler, x))
+const Service::HandlerTable * Scheduler::getHandlers() const {
+    static const HandlerTable handlers = HandlerTable()
+        .addFamily<TaskBagMsg>(SERVICE_HANDLER(Scheduler, TaskBagMsg))
+        HANDLE_MESSAGE(TaskStateChgMsg)
+        HANDLE_MESSAGE(RescheduleTimer)
+        HANDLE_MESSAGE(AbortTaskMsg)
+        HANDLE_MESSAGE(MonitorTimer);
+    return &handlers;
 }
 
 
@@ -25,6 +25,10 @@
 #include "TaskEventMsg.hpp"
 #include "TaskStateChgMsg.hpp"
 #include "TaskBagMsg.hpp"
+#include "RequestTimeout.hpp"
+#include "RescheduleTimer.hpp"
+#include "UpdateTimer.hpp"
+#include "UpdateRequestMsg.hpp"
 
 REGISTER_MESSAGE(TaskBagMsg);
 REGISTER_MESSAGE(TaskEventMsg);
@@ -33,3 +37,7 @@ REGISTER_MESSAGE(DispatchCommandMsg);
 REGISTER_MESSAGE(AcceptTaskMsg);
 REGISTER_MESSAGE(AbortTaskMsg);
 REGISTER_MESSAGE(TaskMonitorMsg);
+REGISTER_MESSAGE(RequestTimeout);
+REGISTER_MESSAGE(RescheduleTimer);
+REGISTER_MESSAGE(UpdateTimer);
+REGISTER_MESSAGE(UpdateRequestMsg);
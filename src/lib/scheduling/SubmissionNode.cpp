@@ -41,6 +41,7 @@ class HeartbeatTimeout : public BasicMsg {
 public:
     MESSAGE_SUBCLASS(HeartbeatTimeout);
 
+    HeartbeatTimeout() {}
     HeartbeatTimeout(const CommAddress & src) : executionNode(src) {}
 
     const CommAddress & getExecutionNode() const {
@@ -49,6 +50,7 @@ public:
 
     EMPTY_MSGPACK_DEFINE();
 };
+REGISTER_MESSAGE(HeartbeatTimeout);
 
 
 void SubmissionNode::finishedApp(int64_t appId) {}
@@ -74,7 +76,7 @@ void SubmissionNode::sendRequest(int64_t appInstance, int prevRetries) {
         // Set a request timeout of 30 seconds
         Time timeout = Time::getCurrentTime() + Duration(ConfigurationManager::getInstance().getRequestTimeout());
         // Schedule the timeout message
-        std::shared_ptr<RequestTimeout> rt(new RequestTimeout);
+        std::shared_ptr<RequestTimeout> rt = RequestTimeout::create();
         rt->setRequestId(reqId);
         CommLayer::getInstance().setTimer(timeout, rt);
         if (db.startSearch(reqId, timeout)) {
@@ -156,7 +158,7 @@ template<> void SubmissionNode::handle(const CommAddress & src, const AcceptTask
             int & timer = heartbeats.insert(make_pair(src, 0)).first->second;
             if (timer == 0) {
                 timer = CommLayer::getInstance().setTimer(Duration(2.5 * msg.getHeartbeat()),
-                        std::shared_ptr<HeartbeatTimeout>(new HeartbeatTimeout(src)));
+                        HeartbeatTimeout::create(src));
             }
             // Count tasks
             remoteTasks[src].insert(make_pair(appId, 0)).first->second += numAccepted;
@@ -246,7 +248,7 @@ template<> void SubmissionNode::handle(const CommAddress & src, const TaskMonito
     // If there are still any remote task in that execution node, reprogram a heartbeat timeout
     if (!tasksPerApp.empty())
         hb = CommLayer::getInstance().setTimer(Duration(2.5 * msg.getHeartbeat()),
-                std::shared_ptr<HeartbeatTimeout>(new HeartbeatTimeout(src)));
+                HeartbeatTimeout::create(src));
     else {
         remoteTasks.erase(src);
         heartbeats.erase(src);
@@ -269,12 +271,13 @@ template<> void SubmissionNode::handle(const CommAddress & src, const HeartbeatT
 }
 
 
-#define HANDLE_MESSAGE(x) if (typeid(msg) == typeid(x)) { handle(src, static_cast<const x &>(msg)); return true; }
-bool SubmissionNode::receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-    HANDLE_MESSAGE(DispatchCommandMsg)
-    HANDLE_MESSAGE(AcceptTaskMsg)
-    HANDLE_MESSAGE(RequestTimeout)
-    HANDLE_MESSAGE(TaskMonitorMsg)
-    HANDLE_MESSAGE(HeartbeatTimeout)
-    return false;
+#define HANDLE_MESSAGE(x) .add<x>(SERVICE_HANDLER(SubmissionNode, x))
+const Service::HandlerTable * SubmissionNode::getHandlers() const {
+    static const HandlerTable handlers = HandlerTable()
+        HANDLE_MESSAGE(DispatchCommandMsg)
+        HANDLE_MESSAGE(AcceptTaskMsg)
+        HANDLE_MESSAGE(RequestTimeout)
+        HANDLE_MESSAGE(TaskMonitorMsg)
+        HANDLE_MESSAGE(HeartbeatTimeout);
+    return &handlers;
 }
@@ -29,6 +29,7 @@ using namespace std;
 
 
 REGISTER_MESSAGE(DPAvailabilityInformation);
+REGISTER_MESSAGE(DPAvailabilityDelta);
 
 
 unsigned int DPAvailabilityInformation::numClusters = 125;
@@ -109,6 +110,15 @@ bool DPAvailabilityInformation::MDFCluster::far(const MDFCluster & r) const {
 }
 
 
+void DPAvailabilityInformation::MDFCluster::getCoordinates(double * c) const {
+    c[0] = reference->memRange ? (minM - reference->minM) * numIntervals / reference->memRange : 0;
+    c[1] = reference->diskRange ? (minD - reference->minD) * numIntervals / reference->diskRange : 0;
+    c[2] = minA.isFree();
+    c[3] = reference->availRange ?
+            floor(minA.sqdiff(reference->minA, reference->aggregationTime, reference->horizon) * numIntervals / reference->availRange) : 0.0;
+}
+
+
 void DPAvailabilityInformation::MDFCluster::reduce() {
     accumAsq += minA.reduceMin(value, accumMaxA, reference->aggregationTime, reference->horizon);
     accumMaxA.reduceMax(reference->aggregationTime, reference->horizon);
@@ -157,12 +167,19 @@ void DPAvailabilityInformation::join(const DPAvailabilityInformation & r) {
             maxA.max(maxA, r.maxA);
             if (horizon < r.horizon) horizon = r.horizon;
         }
-        summary.insert(summary.end(), r.summary.begin(), r.summary.end());
+        summary.append(r.summary);
     }
 }
 
 
 void DPAvailabilityInformation::reduce() {
+    Reduction scratch;
+    reduce(scratch);
+}
+
+
+void DPAvailabilityInformation::reduce(Reduction & previous) {
+    summary.reuse(previous);
     for (auto & i : summary)
         i.setReference(this);
     // Set up clustering variables
@@ -170,9 +187,8 @@ void DPAvailabilityInformation::reduce() {
     memRange = maxM - minM;
     diskRange = maxD - minD;
     availRange = maxA.sqdiff(minA, aggregationTime, horizon);
-    summary.cluster(numClusters);
-    for (auto & i : summary)
-        i.reduce();
+    // The clusters of the previous reduction are already reduced
+    summary.cluster(numClusters, previous, [](MDFCluster & c) { c.reduce(); });
 }
 
 
@@ -188,7 +204,7 @@ void DPAvailabilityInformation::getAvailability(list<AssignmentInfo> & ai, const
             if (i.value > 0 && avail >= desc.getLength() && i.minM >= desc.getMaxMemory() && i.minD >= desc.getMaxDisk()) {
                 unsigned int numTasks = avail / desc.getLength();
                 unsigned long int restAvail = avail % desc.getLength();
-                ai.push_back(AssignmentInfo(const_cast<MDFCluster *>(&i), i.value * numTasks, i.minM - desc.getMaxMemory(), i.minD - desc.getMaxDisk(), restAvail));
+                ai.push_back(AssignmentInfo(&i, i.value * numTasks, i.minM - desc.getMaxMemory(), i.minD - desc.getMaxDisk(), restAvail));
             }
         }
     }
@@ -196,9 +212,15 @@ void DPAvailabilityInformation::getAvailability(list<AssignmentInfo> & ai, const
 
 
 void DPAvailabilityInformation::update(const list<DPAvailabilityInformation::AssignmentInfo> & ai, const TaskDescription & desc) {
+    vector<size_t> positions;
+    for (list<AssignmentInfo>::const_iterator it = ai.begin(); it != ai.end(); it++)
+        positions.push_back(summary.positionOf(it->cluster));
+    vector<MDFCluster> newClusters;
+    newClusters.reserve(ai.size());
     // For each cluster
-    for (list<AssignmentInfo>::const_iterator it = ai.begin(); it != ai.end(); it++) {
-        MDFCluster & cluster = *it->cluster;
+    vector<size_t>::iterator pos = positions.begin();
+    for (list<AssignmentInfo>::const_iterator it = ai.begin(); it != ai.end(); it++, pos++) {
+        MDFCluster & cluster = summary[*pos];
         double avail = cluster.minA.getAvailabilityBefore(desc.getDeadline());
         uint64_t tasksPerNode = avail / desc.getLength();
         if (tasksPerNode > 0) {
@@ -216,10 +238,11 @@ void DPAvailabilityInformation::update(const list<DPAvailabilityInformation::Ass
             else
                 tmp.minA.update(desc.getLength() * tasksPerNode, desc.getDeadline(), horizon);
 
-            summary.push_back(tmp);
             minA.min(minA, tmp.minA);
+            newClusters.push_back(tmp);
         }
     }
+    summary.append(std::move(newClusters));
 }
 
 
@@ -62,25 +62,12 @@ void DPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
     }
 
     // Check if we already routed this request recently
-    Time now = Time::getCurrentTime();
-    {
-        list<RecentRequest>::iterator it = recentRequests.begin();
-        while (it != recentRequests.end() && now - it->when > REQUEST_CACHE_TIME)
-            it = recentRequests.erase(it);
-        while (it != recentRequests.end() && !(it->requestId == msg.getRequestId() && it->requester == msg.getRequester()))
-            it++;
-        if (it != recentRequests.end()) {
-            recentRequests.push_back(RecentRequest(msg.getRequester(), msg.getRequestId(), now));
-            recentRequests.erase(it);
-            if (father.addr != CommAddress()) {
-                CommLayer::getInstance().sendMessage(father.addr, msg.clone());
-            }
-            return;
+    if (recentRequests.touch(RequestKey(msg.getRequester(), msg.getRequestId()), Time::getCurrentTime())) {
+        if (father.addr != CommAddress()) {
+            CommLayer::getInstance().sendMessage(father.addr, msg.clone());
         }
+        return;
     }
-    // The request wasn't in the cache
-    recentRequests.push_back(RecentRequest(msg.getRequester(), msg.getRequestId(), now));
-    if (recentRequests.size() > REQUEST_CACHE_SIZE) recentRequests.pop_front();
 
     const TaskDescription & req = msg.getMinRequirements();
     unsigned int remainingTasks = msg.getLastTask() - msg.getFirstTask() + 1;
@@ -128,10 +115,10 @@ void DPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
         }
     }
 
-    // Update the availability information
+    // Update the availability information of the children that get tasks
     for (int c : {0, 1})
-        if (child[c].availInfo.get()) {
-            child[c].availInfo->update(assign[c], req);
+        if (!assign[c].empty()) {
+            detach(child[c].availInfo).update(assign[c], req);
             child[c].hasNewInformation = true;
         }
     // Send the result to the father
@@ -36,6 +36,7 @@ using std::make_pair;
 namespace stars {
 
 REGISTER_MESSAGE(FSPAvailabilityInformation);
+REGISTER_MESSAGE(FSPAvailabilityDelta);
 
 
 unsigned int FSPAvailabilityInformation::numClusters = 125;
@@ -60,6 +61,12 @@ bool FSPAvailabilityInformation::MDZCluster::far(const MDZCluster & r) const {
 }
 
 
+void FSPAvailabilityInformation::MDZCluster::getCoordinates(double * c) const {
+    c[0] = minM.getCoordinate(reference->memoryRange, numIntervals);
+    c[1] = minD.getCoordinate(reference->diskRange, numIntervals);
+}
+
+
 void FSPAvailabilityInformation::MDZCluster::aggregate(const MDZCluster & r) {
     Logger::msg("Ex.RI.Aggr", DEBUG, "Aggregating ", *this, " and ", r);
     ZAFunction newMaxL;
@@ -85,28 +92,62 @@ void FSPAvailabilityInformation::setAvailability(uint32_t m, uint32_t d, const F
     slownessRange.setLimits(curTasks.getSlowness());   // curTasks must be sorted!!
     summary.clear();
     summary.push_back(MDZCluster(m, d, curTasks, power));
+    memoryIndexValid = false;
     minZ = maxZ = summary.front().maxZ;
     lengthHorizon = minZ.getHorizon();
 }
 
 
-std::list<FSPAvailabilityInformation::MDZCluster *> FSPAvailabilityInformation::getFunctions(const TaskDescription & req) {
-    std::list<MDZCluster *> f;
-    for (auto & i : summary)
-        if (i.fulfills(req))
-            f.push_back(&i);
+void FSPAvailabilityInformation::buildMemoryIndex() const {
+    memoryIndex.resize(summary.size());
+    for (uint32_t i = 0; i < summary.size(); ++i)
+        memoryIndex[i] = i;
+    // Compare memory as fulfills does, as an unsigned value
+    std::stable_sort(memoryIndex.begin(), memoryIndex.end(), [this](uint32_t l, uint32_t r) {
+        return (uint32_t)summary[l].minM.getValue() > (uint32_t)summary[r].minM.getValue();
+    });
+    memoryIndexValid = true;
+}
+
+
+std::list<const FSPAvailabilityInformation::MDZCluster *> FSPAvailabilityInformation::getFunctions(const TaskDescription & req) const {
+    if (!memoryIndexValid)
+        buildMemoryIndex();
+    // The clusters with enough memory are a prefix of the index
+    std::vector<uint32_t> found;
+    for (uint32_t i : memoryIndex) {
+        if ((uint32_t)summary[i].minM.getValue() < req.getMaxMemory())
+            break;
+        if (summary[i].fulfills(req))
+            found.push_back(i);
+    }
+    std::sort(found.begin(), found.end());
+    std::list<const MDZCluster *> f;
+    for (uint32_t i : found)
+        f.push_back(&summary[i]);
     return f;
 }
 
 
-void FSPAvailabilityInformation::removeClusters(const std::list<MDZCluster *> & clusters) {
-    auto it = summary.begin();
-    for (auto c : clusters) {
-        while (it != summary.end() && &(*it) != c)
-            ++it;
-        if (it != summary.end())
-            it = summary.erase(it);
+void FSPAvailabilityInformation::removeClusters(const std::list<const MDZCluster *> & clusters) {
+    std::vector<size_t> positions;
+    for (auto c : clusters)
+        positions.push_back(summary.positionOf(c));
+    // Mark them as empty, as the clustering algorithm does, and compact everything once
+    std::vector<MDZCluster> & v = summary.detach();
+    for (size_t i : positions)
+        v[i].value = 0;
+    if (memoryIndexValid) {
+        std::vector<uint32_t> newPosition(v.size());
+        for (uint32_t i = 0, n = 0; i < v.size(); ++i)
+            newPosition[i] = v[i].value ? n++ : 0;
+        memoryIndex.erase(std::remove_if(memoryIndex.begin(), memoryIndex.end(), [&v](uint32_t i) {
+            return v[i].value == 0;
+        }), memoryIndex.end());
+        for (uint32_t & i : memoryIndex)
+            i = newPosition[i];
     }
+    summary.purge();
 }
 
 
@@ -136,7 +177,8 @@ void FSPAvailabilityInformation::join(const FSPAvailabilityInformation & r) {
                 lengthHorizon = r.lengthHorizon;
             slownessRange.extend(r.slownessRange);
         }
-        summary.insert(summary.end(), r.summary.begin(), r.summary.end());
+        summary.append(r.summary);
+        memoryIndexValid = false;
     }
 }
 
@@ -149,22 +191,25 @@ void saveToFile(FSPAvailabilityInformation * fspai) {
 
 
 void FSPAvailabilityInformation::reduce() {
+    Reduction scratch;
+    reduce(scratch);
+}
+
+
+void FSPAvailabilityInformation::reduce(Reduction & previous) {
+    summary.reuse(previous);
     // Set up clustering variables
     slownessSquareDiff = maxZ.sqdiff(minZ, lengthHorizon);
     for (auto & i : summary)
         i.reference = this;
     //FSPAvailabilityInformation * copy = this->clone();
     auto start = std::chrono::high_resolution_clock::now();
-    summary.cluster(numClusters);
+    // The clusters of the previous reduction are already reduced
+    summary.cluster(numClusters, previous, [](MDZCluster & c) { c.reduce(); });
+    memoryIndexValid = false;
     auto end = std::chrono::high_resolution_clock::now();
     auto mus = std::chrono::duration<double>(end - start);
-    Logger::msg("Ex.RI.Aggr.FSP", INFO, "Clustering lasted ", mus.count() * 1000000.0, " us");
-    start = end;
-    for (auto & i : summary)
-        i.reduce();
-    end = std::chrono::high_resolution_clock::now();
-    mus = std::chrono::duration<double>(end - start);
-    Logger::msg("Ex.RI.Aggr.FSP", INFO, "Reduction lasted ", mus.count() * 1000000.0, " us");
+    Logger::msg("Ex.RI.Aggr.FSP", INFO, "Clustering and reduction lasted ", mus.count() * 1000000.0, " us");
 //    if (mus > 30000)
 //        saveToFile(copy);
 //    delete copy;
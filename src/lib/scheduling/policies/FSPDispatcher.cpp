@@ -20,6 +20,7 @@
 
 #include "Logger.hpp"
 #include "FSPDispatcher.hpp"
+#include "FSPFunctionVector.hpp"
 #include "Time.hpp"
 #include "ConfigurationManager.hpp"
 #include "FSPTaskBagMsg.hpp"
@@ -32,123 +33,13 @@ namespace stars {
 REGISTER_MESSAGE(FSPTaskBagMsg);
 }
 
-struct FunctionInfo {
-    FSPAvailabilityInformation::MDZCluster * cluster;
-    int child;
-    double slowness;
-    int tasks;
-};
-
-
-class FSPDispatcher::FunctionVector : public std::vector<FunctionInfo> {
-public:
-    FunctionVector(std::list<FSPAvailabilityInformation::MDZCluster *> clusters[2], const std::array<double, 2> & bs)
-            : std::vector<FunctionInfo>(clusters[0].size() + clusters[1].size()),
-              totalTasks(0), diffWithRequest(0), minSlowness(INFINITY),
-              branchSlowness(bs), worstChild(0) {
-        size_t j = 0;
-        totalNodes = 0;
-        for (int c : {0, 1}) {
-            nodesPerBranch[c] = totalNodes;
-            for (auto i : clusters[c]) {
-                (*this)[j].cluster = i;
-                (*this)[j].child = c;
-                (*this)[j].slowness = INFINITY;
-                (*this)[j].tasks = 0;
-                totalNodes += i->getValue();
-                ++j;
-            }
-            nodesPerBranch[c] = totalNodes - nodesPerBranch[c];
-        }
-    }
-
-    void computeTasksPerFunction(unsigned int numTasksReq, uint64_t a) {
-        if (!empty()) {
-            minSlowness = 0.0;
-            for (int currentTpn = 1; totalTasks < numTasksReq; ++currentTpn) {
-                vector<std::pair<double, FunctionInfo *>> slownessHeap;
-                for (auto & func : *this) {
-                    double slowness = currentTpn == 1 ?
-                            func.cluster->getMaximumSlowness().getSlowness(a)
-                            : func.cluster->getMaximumSlowness().estimateSlowness(a, currentTpn);
-                    // Check that it is not under the minimum of its branch
-                    if (slowness < branchSlowness[func.child]) {
-                        slowness = branchSlowness[func.child];
-                    }
-                    slownessHeap.push_back(std::make_pair(slowness, &func));
-                    std::push_heap(slownessHeap.begin(), slownessHeap.end(), compare);
-                }
-                while (!slownessHeap.empty() && totalTasks < numTasksReq) {
-                    std::pop_heap(slownessHeap.begin(), slownessHeap.end(), compare);
-                    auto & func = *slownessHeap.back().second;
-                    func.tasks++;
-                    func.slowness = slownessHeap.back().first;
-                    minSlowness = func.slowness;
-                    worstChild = func.child;
-                    totalTasks += func.cluster->getValue();
-                    slownessHeap.pop_back();
-                }
-            }
-            diffWithRequest = totalTasks - numTasksReq;
-            updateBranchSlowness();
-        }
-    }
-
-    const std::array<double, 2> & getNewBranchSlowness() const { return branchSlowness; }
-
-    double getMinimumSlowness() const {
-        return minSlowness;
-    }
-
-    std::array<unsigned int, 2> computeTasksPerBranch() {
-        std::array<unsigned int, 2> tpb = {0, 0};
-        for (auto & func : *this) {
-            if (func.tasks) {
-                unsigned int tasksToCluster = func.tasks * func.cluster->getValue();
-                tpb[func.child] += tasksToCluster;
-            }
-        }
-        tpb[worstChild] -= diffWithRequest;
-        return tpb;
-    }
-
-    unsigned int getTotalNodes() const {
-        return totalNodes;
-    }
-
-    unsigned int getNodesOfBranch(int c) const {
-        return nodesPerBranch[c];
-    }
-
-private:
-    unsigned int totalTasks, diffWithRequest, totalNodes;
-    unsigned int nodesPerBranch[2];
-    double minSlowness;
-    std::array<double, 2> branchSlowness;
-    int worstChild;
-
-    static bool compare(const std::pair<double, FunctionInfo *> & l, const std::pair<double, FunctionInfo *> & r) {
-        return l.first > r.first;
-    }
-
-    void updateBranchSlowness() {
-        for (auto & func : *this) {
-            if (func.tasks) {
-                if (branchSlowness[func.child] < func.slowness) {
-                    branchSlowness[func.child] = func.slowness;
-                }
-            }
-        }
-    }
-};
-
 
 void FSPDispatcher::informationUpdated() {
 }
 
 
 void FSPDispatcher::removeUsedClusters(const FunctionVector& functions) {
-    std::list<FSPAvailabilityInformation::MDZCluster*> clusters[2];
+    std::list<const FSPAvailabilityInformation::MDZCluster *> clusters[2];
     for (auto & func : functions) {
         if (func.tasks) {
             clusters[func.child].push_back(func.cluster);
@@ -156,7 +47,7 @@ void FSPDispatcher::removeUsedClusters(const FunctionVector& functions) {
     }
     for (int c : { 0, 1 }) {
         if (!clusters[c].empty()) {
-            child[c].availInfo->removeClusters(clusters[c]);
+            detach(child[c].availInfo).removeClusters(clusters[c]);
             child[c].hasNewInformation = true;
         }
     }
@@ -192,12 +83,13 @@ void FSPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
     uint64_t a = req.getLength();
 
     std::unique_ptr<stars::FSPTaskBagMsg> msgCopy = createMsgCopy(msg);
-    std::list<FSPAvailabilityInformation::MDZCluster *> clusters[2];
+    std::list<const FSPAvailabilityInformation::MDZCluster *> clusters[2];
     std::array<double, 2> branchSlowness = {0.0, 0.0};
     for (int c : {0, 1}) {
         if (child[c].availInfo.get()) {
             Logger::msg("Dsp.FSP", DEBUG, "Getting functions of children (", child[c].addr, "): ", *child[c].availInfo);
-            clusters[c] = std::move(child[c].availInfo->getFunctions(req));
+            // The information is only copied if the clusters are removed later
+            clusters[c] = child[c].availInfo->getFunctions(req);
             branchSlowness[c] = child[c].availInfo->getMinimumSlowness();
         }
     }
@@ -269,11 +161,14 @@ double FSPDispatcher::getSlownessLimit() const {
 
 void FSPDispatcher::updateBranchSlowness(const std::array<double, 2> & branchSlowness) {
     for (int c : {0, 1}) {
-        if (child[c].availInfo.get()) {
-            child[c].availInfo->setMinimumSlowness(branchSlowness[c]);
-            if (child[c].availInfo->getMaximumSlowness() < branchSlowness[c]) {
-                child[c].availInfo->setMaximumSlowness(branchSlowness[c]);
+        // The maximum is never below the minimum, so nothing changes if the minimum is the same
+        if (child[c].availInfo.get() && child[c].availInfo->getMinimumSlowness() != branchSlowness[c]) {
+            FSPAvailabilityInformation & info = detach(child[c].availInfo);
+            info.setMinimumSlowness(branchSlowness[c]);
+            if (info.getMaximumSlowness() < branchSlowness[c]) {
+                info.setMaximumSlowness(branchSlowness[c]);
             }
+            child[c].hasNewInformation = true;
         }
     }
 }
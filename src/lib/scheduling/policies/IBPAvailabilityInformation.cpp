@@ -22,6 +22,7 @@
 
 
 REGISTER_MESSAGE(IBPAvailabilityInformation);
+REGISTER_MESSAGE(IBPAvailabilityDelta);
 
 
 unsigned int IBPAvailabilityInformation::numClusters = 256;
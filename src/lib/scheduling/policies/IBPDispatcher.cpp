@@ -29,7 +29,7 @@
  * A block of info associated with a NodeGroup used in the decision algorithm.
  */
 struct IBPDispatcher::DecisionInfo {
-    IBPAvailabilityInformation::MDCluster & cluster;
+    const IBPAvailabilityInformation::MDCluster & cluster;
     int branch;
     double distance;
     uint64_t availability;
@@ -37,7 +37,7 @@ struct IBPDispatcher::DecisionInfo {
     static const uint32_t ALPHA_MEM = 10;
     static const uint32_t ALPHA_DISK = 1;
 
-    DecisionInfo(IBPAvailabilityInformation::MDCluster & c, uint32_t mem, uint32_t disk, int b, double d)
+    DecisionInfo(const IBPAvailabilityInformation::MDCluster & c, uint32_t mem, uint32_t disk, int b, double d)
             : cluster(c), branch(b), distance(d),
               availability((c.getRemainingMemory(mem)) * ALPHA_MEM + (c.getRemainingDisk(disk)) * ALPHA_DISK) {}
 
@@ -67,10 +67,10 @@ void IBPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
     // Ignore the zone that has sent this message, only if it is a StructureNode, and zones without information
     for (int c : {0, 1}) {
         if ((msg.isFromEN() || child[c].addr != src) && child[c].availInfo.get()) {
-            std::list<IBPAvailabilityInformation::MDCluster *> nodeGroups;
+            std::list<const IBPAvailabilityInformation::MDCluster *> nodeGroups;
             child[c].availInfo->getAvailability(nodeGroups, req);
             Logger::msg("Dsp.Simple", DEBUG, "Obtained ", nodeGroups.size(), " groups with enough availability from left child.");
-            for (std::list<IBPAvailabilityInformation::MDCluster *>::iterator git = nodeGroups.begin(); git != nodeGroups.end(); git++) {
+            for (std::list<const IBPAvailabilityInformation::MDCluster *>::iterator git = nodeGroups.begin(); git != nodeGroups.end(); git++) {
                 groups.push_back(DecisionInfo(**git, req.getMaxMemory(), req.getMaxDisk(), c, branch.getChildDistance(c, msg.getRequester())));
             }
         }
@@ -81,15 +81,18 @@ void IBPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
 
     // Now divide the request between the zones
     std::array<unsigned int, 2> numTasks = {0, 0};
+    std::list<std::pair<const IBPAvailabilityInformation::MDCluster *, uint32_t> > taken[2];
     for (std::list<DecisionInfo>::iterator it = groups.begin(); it != groups.end() && remainingTasks; ++it) {
         Logger::msg("Dsp.Simple", DEBUG, "Using group from ", (it->branch == 0 ? "left" : "right"), " branch and ", it->cluster.getValue(), " nodes, availability is ", it->availability);
-        uint32_t numTaken = remainingTasks - it->cluster.takeUpToNodes(remainingTasks);
+        uint32_t numTaken = std::min(remainingTasks, it->cluster.getValue());
+        taken[it->branch].push_back(std::make_pair(&it->cluster, numTaken));
         numTasks[it->branch] += numTaken;
         remainingTasks -= numTaken;
     }
+    // Only the information of the children that get tasks is modified
     for (int c : {0, 1})
         if (numTasks[c]) {
-            child[c].availInfo->updated();
+            detach(child[c].availInfo).takeNodes(taken[c]);
             child[c].hasNewInformation = true;
         }
     recomputeInfo();
@@ -27,6 +27,7 @@ using namespace std;
 
 
 REGISTER_MESSAGE(MMPAvailabilityInformation);
+REGISTER_MESSAGE(MMPAvailabilityDelta);
 
 
 unsigned int MMPAvailabilityInformation::numClusters = 256;
@@ -79,37 +80,95 @@ void MMPAvailabilityInformation::join(const MMPAvailabilityInformation & r) {
 }
 
 
-Time MMPAvailabilityInformation::getAvailability(list<MDPTCluster *> & clusters,
-        unsigned int numTasks, const TaskDescription & req) {
-    TaskDescription tmp(req);
-    Time max = Time::getCurrentTime(), min;
+/**
+ * The clusters that fulfill a request, with the time their queue ends, so that the balanced
+ * queue search does not check the requirements of every cluster at every deadline it tries.
+ */
+class QueueIndex {
+public:
+    QueueIndex(const stars::ClusteringList<MMPAvailabilityInformation::MDPTCluster> & summary,
+            const TaskDescription & req, Time now) : length(req.getLength() ? req.getLength() : 1000) {
+        entries.resize(summary.size());
+        size_t n = 0;
+        for (auto & c : summary) {
+            if (c.fulfills(req)) {
+                Entry & e = entries[n++];
+                e.start = c.getMaximumQueue() > now ? c.getMaximumQueue() : now;
+                e.power = c.getMinimumPower();
+                e.cluster = &c;
+            }
+        }
+        entries.resize(n);
+    }
+
+    /**
+     * Counts the tasks that fit before a deadline, like MMPAvailabilityInformation::getAvailability.
+     * @param deadline The deadline.
+     * @param clusters If not null, the list where the clusters with some task are put.
+     * @return The number of tasks.
+     */
+    unsigned int count(Time deadline, list<const MMPAvailabilityInformation::MDPTCluster *> * clusters) const {
+        unsigned int result = 0;
+        for (auto & e : entries) {
+            if (e.start < deadline) {
+                double time = (deadline - e.start).seconds();
+                unsigned long int t = (time * e.power) / length;
+                if (t != 0) {
+                    if (clusters) clusters->push_back(e.cluster);
+                    result += t;
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Entry {
+        Time start;
+        double power;
+        const MMPAvailabilityInformation::MDPTCluster * cluster;
+    };
+
+    unsigned long int length;
+    vector<Entry> entries;   ///< Clusters that fulfill the request, in summary order
+};
+
+
+Time MMPAvailabilityInformation::getAvailability(list<const MDPTCluster *> & clusters,
+        unsigned int numTasks, const TaskDescription & req) const {
+    Time now = Time::getCurrentTime();
+    QueueIndex index(summary, req, now);
+    Time max = now, min, probed;
     int64_t d = 300000000;
     unsigned int t = 0;
     while (t < numTasks && d < 1000000000000000000L) {
-        clusters.clear();
         min = max;
         max += Duration(d);
         d *= 2;
-        tmp.setDeadline(max);
-        t = getAvailability(clusters, tmp);
+        t = index.count(max, NULL);
+        probed = max;
     }
     unsigned int last = 0;
     while (last != t) {
-        clusters.clear();
         last = t;
         d /= 2;
         Time med = min + Duration(d);
-        tmp.setDeadline(med);
-        t = getAvailability(clusters, tmp);
+        t = index.count(med, NULL);
+        probed = med;
         if (t < numTasks) min = med;
         else max = med;
     }
+    // Only the last deadline tried returns its clusters
+    if (numTasks > 0) {
+        clusters.clear();
+        index.count(probed, &clusters);
+    }
 
     return max;
 }
 
 
-unsigned int MMPAvailabilityInformation::getAvailability(list<MDPTCluster *> & clusters, const TaskDescription & req) {
+unsigned int MMPAvailabilityInformation::getAvailability(list<const MDPTCluster *> & clusters, const TaskDescription & req) const {
     unsigned int result = 0;
     Time now = Time::getCurrentTime();
     for (auto & c : summary) {
@@ -129,11 +188,19 @@ unsigned int MMPAvailabilityInformation::getAvailability(list<MDPTCluster *> & c
 }
 
 
+void MMPAvailabilityInformation::updateMaximumQueue(const list<const MDPTCluster *> & clusters, Time m) {
+    vector<size_t> positions;
+    for (list<const MDPTCluster *>::const_iterator it = clusters.begin(); it != clusters.end(); it++)
+        positions.push_back(summary.positionOf(*it));
+    for (size_t i : positions)
+        summary[i].updateMaximumQueue(m);
+}
+
+
 void MMPAvailabilityInformation::updateAvailability(const TaskDescription & req) {
-    list<MDPTCluster *> clusters;
+    list<const MDPTCluster *> clusters;
     getAvailability(clusters, req);
-    for (list<MDPTCluster *>::iterator it = clusters.begin(); it != clusters.end(); it++)
-        (*it)->maxT = stars::MaxParameter<Time, int64_t>(req.getDeadline());
+    updateMaximumQueue(clusters, req.getDeadline());
     if (!clusters.empty() && queueRange.getMax() < req.getDeadline())
         queueRange.setMaximum(req.getDeadline());
 }
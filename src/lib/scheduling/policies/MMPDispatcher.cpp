@@ -62,7 +62,7 @@ void MMPDispatcher::recomputeChildrenInfo() {
  * A block of info associated with a NodeGroup used in the decission algorithm.
  */
 struct MMPDispatcher::DecissionInfo {
-    MMPAvailabilityInformation::MDPTCluster * cluster;
+    const MMPAvailabilityInformation::MDPTCluster * cluster;
     int branch;
     double distance;
     double availability;
@@ -72,7 +72,7 @@ struct MMPDispatcher::DecissionInfo {
     static const uint32_t ALPHA_DISK = 1;
     static const uint32_t ALPHA_TIME = 100;
 
-    DecissionInfo(MMPAvailabilityInformation::MDPTCluster * c, const TaskDescription & req, int b, double d)
+    DecissionInfo(const MMPAvailabilityInformation::MDPTCluster * c, const TaskDescription & req, int b, double d)
             : cluster(c), branch(b), distance(d) {
         double oneTaskTime = req.getLength() / (double)c->getMinimumPower();
         availability = ALPHA_MEM * c->getLostMemory(req)
@@ -100,7 +100,7 @@ void MMPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
     Logger::msg("Dsp.MMP", INFO, "Memory: ", req.getMaxMemory(), "   Disk: ", req.getMaxDisk());
     Logger::msg("Dsp.MMP", INFO, "Length: ", req.getLength());
 
-    std::list<MMPAvailabilityInformation::MDPTCluster *> nodeGroups;
+    std::list<const MMPAvailabilityInformation::MDPTCluster *> nodeGroups;
     if (father.addr != CommAddress()) {
         // Count number of tasks before the minimum length in the rest of the tree
         Time now = Time::getCurrentTime();
@@ -145,7 +145,7 @@ void MMPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
             nodeGroups.clear();
             child[c].availInfo->getAvailability(nodeGroups, req);
             Logger::msg("Dsp.MMP", DEBUG, "Obtained ", nodeGroups.size(), " groups with enough availability from ", c, " child.");
-            for (std::list<MMPAvailabilityInformation::MDPTCluster *>::iterator git = nodeGroups.begin(); git != nodeGroups.end(); git++) {
+            for (std::list<const MMPAvailabilityInformation::MDPTCluster *>::iterator git = nodeGroups.begin(); git != nodeGroups.end(); git++) {
                 Logger::msg("Dsp.MMP", DEBUG, (*git)->getValue(), " tasks of size availability ", req.getLength());
                 groups.push_back(DecissionInfo(*git, req, c, branch.getChildDistance(c, requester)));
             }
@@ -156,6 +156,7 @@ void MMPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
 
     // Now divide the request between the zones
     std::array<unsigned int, 2> numTasks = { 0, 0 };
+    std::list<const MMPAvailabilityInformation::MDPTCluster *> used[2];
     for (std::list<DecissionInfo>::iterator it = groups.begin(); it != groups.end() && remainingTasks; it++) {
         Logger::msg("Dsp.MMP", DEBUG, "Using group from ", (it->branch == 0 ? "left" : "right"), " branch and ", it->numTasks, " tasks");
         unsigned int tasksInGroup = it->numTasks;
@@ -166,12 +167,17 @@ void MMPDispatcher::handle(const CommAddress & src, const TaskBagMsg & msg) {
             numTasks[it->branch] += remainingTasks;
             remainingTasks = 0;
         }
-        it->cluster->updateMaximumQueue(balancedQueue);
+        used[it->branch].push_back(it->cluster);
     }
 
+    // Only the information of the children that get tasks is modified
     for (int c : {0, 1})
-        if (numTasks[c] > 0)
-            child[c].availInfo->updateMaxT(balancedQueue);
+        if (!used[c].empty()) {
+            MMPAvailabilityInformation & info = detach(child[c].availInfo);
+            info.updateMaximumQueue(used[c], balancedQueue);
+            if (numTasks[c] > 0)
+                info.updateMaxT(balancedQueue);
+        }
 
     // Now create and send the messages, do not send up remaining tasks
     sendTasks(msg, numTasks, true);
@@ -20,6 +20,9 @@
 
 #include <utility>
 #include <list>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 #include "ZAFunction.hpp"
 #include "Logger.hpp"
 using std::vector;
@@ -430,7 +433,7 @@ double ZAFunction::reduceMax(double horizon, unsigned int quality) {
 
 vector<ZAFunction> ZAFunction::getReductionOptions(double horizon) const {
     vector<ZAFunction> result(pieces.size() - 1);
-    PieceVector::const_iterator next = ++pieces.begin(), cur = next++, prev = pieces.begin();
+    PieceVector::const_iterator next = pieces.begin() + 1, cur = next++, prev = pieces.begin();
     for (auto & func: result) {
         // Maintain subfunctions from begin to prev - 1
         func.pieces.assign(pieces.begin(), prev);
@@ -501,16 +504,73 @@ bool ZAFunction::SubFunction::isBiggerThan(const SubFunction & l, const SubFunct
 
 
 double ZAFunction::getSlowness(double a) const {
-    PieceVector::const_iterator next = pieces.begin(), it = next++;
-    while (next != pieces.end() && next->covers(a)) it = next++;
-    return it->value(a);
+    return coveringPiece(a).value(a);
 }
 
 
 double ZAFunction::estimateSlowness(uint64_t a, unsigned int n) const {
-    PieceVector::const_iterator next = pieces.begin(), it = next++;
-    while (next != pieces.end() && next->covers(a)) it = next++;
-    return it->value(a, n);
+    return coveringPiece(a).value(a, n);
+}
+
+
+namespace {
+
+// Same operations, in the same order, as SubFunction::value, where z1 * n is a float product
+void evaluatePieces(const double * x, const double * y, const double * z1, const double * z2,
+        size_t count, double a, double n, double * result) {
+    for (size_t i = 0; i < count; ++i)
+        result[i] = x[i] / a + y[i] * a * n + (float)(z1[i] * n) + z2[i];
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_PIECES
+
+// Only AVX2 is enabled, not FMA, so that the products and sums are rounded as in evaluatePieces
+__attribute__((target("avx2")))
+void evaluatePiecesAVX2(const double * x, const double * y, const double * z1, const double * z2,
+        size_t count, double a, double n, double * result) {
+    __m256d va = _mm256_set1_pd(a), vn = _mm256_set1_pd(n);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d r = _mm256_div_pd(_mm256_loadu_pd(x + i), va);
+        r = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(_mm256_loadu_pd(y + i), va), vn));
+        // The product of two floats is exact in double precision, so rounding it gives the float product
+        r = _mm256_add_pd(r, _mm256_cvtps_pd(_mm256_cvtpd_ps(_mm256_mul_pd(_mm256_loadu_pd(z1 + i), vn))));
+        r = _mm256_add_pd(r, _mm256_loadu_pd(z2 + i));
+        _mm256_storeu_pd(result + i, r);
+    }
+    evaluatePieces(x + i, y + i, z1 + i, z2 + i, count - i, a, n, result + i);
+}
+#endif
+
+} // namespace
+
+
+void ZAFunction::SlownessBatch::select(const std::vector<const ZAFunction *> & functions, uint64_t a) {
+    length = a;
+    x.resize(functions.size());
+    y.resize(functions.size());
+    z1.resize(functions.size());
+    z2.resize(functions.size());
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const SubFunction & p = functions[i]->coveringPiece(a);
+        x[i] = p.x;
+        y[i] = p.y;
+        z1[i] = p.z1;
+        z2[i] = p.z2;
+    }
+}
+
+
+void ZAFunction::SlownessBatch::evaluate(unsigned int n, double * result) const {
+#ifdef HAVE_AVX2_PIECES
+    static const bool useAVX2 = __builtin_cpu_supports("avx2");
+    if (useAVX2) {
+        evaluatePiecesAVX2(x.data(), y.data(), z1.data(), z2.data(), x.size(), length, (int)n, result);
+        return;
+    }
+#endif
+    evaluatePieces(x.data(), y.data(), z1.data(), z2.data(), x.size(), length, (int)n, result);
 }
 
 
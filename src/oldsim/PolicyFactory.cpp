@@ -123,10 +123,11 @@ template <class Policy> class PolicyFactoryDist : public PolicyFactory {
         std::shared_ptr<typename Policy::information> & fatherInfo = *static_cast<std::shared_ptr<typename Policy::information> *>(vv[1]);
         if (fatherAddr != CommAddress()) {
             StarsNode & father = sim.getNode(fatherAddr.getIPNum());
+            // Share the snapshot, dispatchers copy it before modifying it
             if (father.getBranch().getChildAddress(0) == localAddress) {
-                fatherInfo.reset(static_cast<typename Policy::dispatcher &>(father.getDisp()).getChildWaitingInfo(0)->clone());
+                fatherInfo = static_cast<typename Policy::dispatcher &>(father.getDisp()).getChildWaitingInfo(0);
             } else {
-                fatherInfo.reset(static_cast<typename Policy::dispatcher &>(father.getDisp()).getChildWaitingInfo(1)->clone());
+                fatherInfo = static_cast<typename Policy::dispatcher &>(father.getDisp()).getChildWaitingInfo(1);
             }
         }
         static_cast<typename Policy::dispatcher &>(disp).recomputeInfo();
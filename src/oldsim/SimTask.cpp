@@ -41,7 +41,7 @@ int SimTask::getStatus() const {
 
 void SimTask::run() {
     if (timer == -1) {
-        std::shared_ptr<TaskStateChgMsg> tfm(new TaskStateChgMsg);
+        std::shared_ptr<TaskStateChgMsg> tfm = TaskStateChgMsg::create();
         tfm->setTaskId(taskId);
         tfm->setOldState(Running);
         tfm->setNewState(Finished);
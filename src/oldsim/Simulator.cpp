@@ -21,6 +21,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 #include <csignal>
+#include <cassert>
 #include <iostream>
 #include <algorithm>
 #include <boost/iostreams/filter/gzip.hpp>
@@ -33,6 +34,7 @@
 #include "SimulationCase.hpp"
 #include "SimTask.hpp"
 #include "util/MemoryManager.hpp"
+#include "util/MessagePool.hpp"
 #include "TrafficStatistics.hpp"
 #include "AvailabilityStatistics.hpp"
 #include "CentralizedScheduler.hpp"
@@ -261,7 +263,9 @@ void Simulator::setProperties(Properties & property) {
         debugStream.push(boost::iostreams::gzip_compressor());
         debugStream.push(debugFile);
     }
-    Logger::initLog(property("log_conf_string", string("")));
+    // Progress messages are shown by default, let them through the priority check of Logger::msg
+    // unless the configuration sets another priority for them
+    Logger::initLog("Sim.Progress=DEBUG;" + property("log_conf_string", string("")));
     Logger::msg("Sim.Progress", 0, "Running simulation test at ", microsec_clock::local_time(), ": ", property);
 
     pstats.openFile(resultDir);
@@ -269,6 +273,7 @@ void Simulator::setProperties(Properties & property) {
 
     // Simulation variables
     measureSize = property("measure_size", true);
+    MessagePool::setEnabled(property("message_pool", true));
     maxRealTime = seconds(property("max_time", 0));
     maxSimTime = Duration(property("max_sim_time", 0.0));
     maxMemUsage = property("max_mem", 0U);
@@ -369,7 +374,7 @@ void Simulator::stepForward() {
 
     pstats.startEvent("Before event");
     if (p->to != p->from) {
-        tstats.msgReceivedAtLevel(getNode(p->to).getBranchLevel(), p->size, p->msg->getName());
+        tstats.msgReceivedAtLevel(getNode(p->to).getBranchLevel(), p->size, *p->msg);
     }
     simCase->beforeEvent(p->from, p->to, *p->msg);
     pstats.endEvent("Before event");
@@ -436,19 +441,15 @@ void Simulator::run() {
 
 
 unsigned long int Simulator::getMsgSize(std::shared_ptr<BasicMsg> msg) {
-    static struct CountBuffer : public std::streambuf {
-        streamsize count;
-        CountBuffer() : streambuf(), count(0) {}
-        streamsize xsputn (const char* s, streamsize n) {
-            count += n;
-            return n;
-        }
-    } buf;
-    static ostream os(&buf);
-    buf.count = 0;
-    msgpack::packer<std::ostream> pk(&os);
+    unsigned long int size = msg->packedSize();
+#ifndef NDEBUG
+    // Check it against the actual serialization
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> pk(&buffer);
     msg->pack(pk);
-    return buf.count;
+    assert(size == buffer.size());
+#endif
+    return size;
 }
 
 
@@ -484,7 +485,7 @@ unsigned int Simulator::sendMessage(uint32_t src, uint32_t dst, std::shared_ptr<
         event = new Event(time + opDuration, txTime + delay, msg, size);
         if (size)
             srcIface.accountSentTraffic(size);
-        tstats.msgSentAtLevel(getNode(src).getBranchLevel(), size, msg->getName());
+        tstats.msgSentAtLevel(getNode(src).getBranchLevel(), size, *msg);
     } else {
         event = new Event(time + opDuration, time + opDuration, msg, 0);
     }
@@ -526,6 +527,13 @@ void Simulator::showStatistics() {
         totalBytesSent, " trf (", numMsgSent, " msg, ", (double)totalBytesSent / numMsgSent, " B/msg, ",
         (totalBytesSent / (time.getRawDate() / 1000000.0)) / routingTable.size(), " Bps/node)   ",
         MemoryManager::getInstance().getUsedMemory(), " mem   100%");
+    Logger::msg("Sim.Progress", 0, real_time.total_microseconds() / (double)numEvents, " us/ev with the message pool ",
+        MessagePool::isEnabled() ? "enabled" : "disabled");
+    if (MessagePool::isEnabled()) {
+        const MessagePool::Stats & mp = MessagePool::getThreadStats();
+        Logger::msg("Sim.Progress", 0, mp.allocations, " pooled message allocations (",
+            (double)mp.allocations / numEvents, " per event, ", 100.0 * mp.reused / mp.allocations, "% reused)");
+    }
     sstats.saveTotalStatistics();
     pstats.saveTotalStatistics();
     tstats.saveTotalStatistics();
@@ -19,6 +19,7 @@
  */
 
 #include <sstream>
+#include <algorithm>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <log4cpp/Category.hh>
@@ -78,7 +79,9 @@ Scheduler::ExecutionEnvironmentImpl::ExecutionEnvironmentImpl()
 
 
 // CommLayer
-CommLayer::CommLayer() : exitSignaled(false) {}
+// Messages are processed as soon as they are enqueued, so the queue never holds more than one
+CommLayer::CommLayer() : messageQueue(2), exitSignaled(false),
+        measuring(false), statsPeriod(0), nextSnapshot(0) {}
 
 
 CommLayer & CommLayer::getInstance() {
@@ -99,29 +102,12 @@ Time Time::getCurrentTime() {
 
 
 int CommLayer::setTimerImpl(Time time, std::shared_ptr<BasicMsg> msg) {
-    Timer t(time, msg);
-    t.id <<= 1;
-    // Set a new timer if this timer is the first or comes before the first
-    if (timerList.empty() || time < timerList.front().timeout) {
-        Simulator::getInstance().injectMessage(localAddress.getIPNum(), localAddress.getIPNum(),
-            timerMsg, time - Simulator::getInstance().getCurrentTime());
-        ++t.id;
-    }
-    // Add a task to the timer structure
-    timerList.push_front(t);
-    timerList.sort();
-    return t.id >> 1;
+    return static_cast<StarsNode *>(this)->setSimTimer(time, msg);
 }
 
 
 void CommLayer::cancelTimer(int timerId) {
-    // Erase timer in list
-    for (std::list<Timer>::iterator it = timerList.begin(); it != timerList.end(); it++) {
-        if (it->id >> 1 == timerId) {
-            timerList.erase(it);
-            break;
-        }
-    }
+    static_cast<StarsNode *>(this)->cancelSimTimer(timerId);
 }
 
 
@@ -168,6 +154,8 @@ void StarsNode::Configuration::setup(const Properties & property) {
 void StarsNode::libStarsConfigure(const Properties & property) {
     ConfigurationManager::getInstance().setUpdateBandwidth(property("update_bw", 1000.0));
     ConfigurationManager::getInstance().setSlownessRatio(property("stretch_ratio", 2.0));
+    ConfigurationManager::getInstance().setIncrementalReductions(property("incremental_reductions", 16U));
+    ConfigurationManager::getInstance().setDeltaUpdates(property("delta_updates", 8U));
     ConfigurationManager::getInstance().setHeartbeat(property("heartbeat", 300));
     ConfigurationManager::getInstance().setWorkingPath(Simulator::getInstance().getResultDir());
     ConfigurationManager::getInstance().setSubmitRetries(property("submit_retries", 3));
@@ -188,6 +176,11 @@ void StarsNode::libStarsConfigure(const Properties & property) {
             stars::FSPAvailabilityInformation::setNumClusters(clusters);
         }
     }
+    unsigned int clusteringThreads = property("clustering_threads", 1U);
+    stars::ClusteringList<IBPAvailabilityInformation::MDCluster>::setNumThreads(clusteringThreads);
+    stars::ClusteringList<MMPAvailabilityInformation::MDPTCluster>::setNumThreads(clusteringThreads);
+    stars::ClusteringList<DPAvailabilityInformation::MDFCluster>::setNumThreads(clusteringThreads);
+    stars::ClusteringList<stars::FSPAvailabilityInformation::MDZCluster>::setNumThreads(clusteringThreads);
     stars::LDeltaFunction::setNumPieces(property("dp_pieces", 8U));
     stars::ZAFunction::setNumPieces(property("fsp_pieces", 10U));
     stars::ZAFunction::setReductionQuality(property("fsp_reduction_quality", 1U));
@@ -218,6 +211,37 @@ void StarsNode::setup(unsigned int addr) {
 }
 
 
+int StarsNode::setSimTimer(Time time, std::shared_ptr<BasicMsg> msg) {
+    SimTimer t(time, msg);
+    purgeCancelledTimers();
+    // Set a new timer if this timer is the first or comes before the first
+    if (timerHeap.empty() || time < timerHeap.front().timeout) {
+        Simulator::getInstance().injectMessage(localAddress.getIPNum(), localAddress.getIPNum(),
+            timerMsg, time - Simulator::getInstance().getCurrentTime());
+        t.armed = true;
+    }
+    // Add a task to the timer structure
+    timerHeap.push_back(t);
+    std::push_heap(timerHeap.begin(), timerHeap.end());
+    liveTimers.insert(t.id);
+    return t.id;
+}
+
+
+void StarsNode::cancelSimTimer(int timerId) {
+    // Cancelled timers are removed from the heap when they reach the top
+    liveTimers.erase(timerId);
+}
+
+
+void StarsNode::purgeCancelledTimers() {
+    while (!timerHeap.empty() && !liveTimers.count(timerHeap.front().id)) {
+        std::pop_heap(timerHeap.begin(), timerHeap.end());
+        timerHeap.pop_back();
+    }
+}
+
+
 unsigned int StarsNode::sendMessage(uint32_t dst, std::shared_ptr<BasicMsg> msg) {
     return Simulator::getInstance().sendMessage(localAddress.getIPNum(), dst, msg);
 }
@@ -227,19 +251,24 @@ void StarsNode::receiveMessage(uint32_t src, unsigned int size, std::shared_ptr<
     // Check if it is the timer
     if (msg == timerMsg) {
         Time ct = Time::getCurrentTime();
-        while (!timerList.empty()) {
-            if (timerList.front().timeout <= ct) {
-                if (timerList.front().timeout < ct)
-                    Logger::msg("Sim.Progress", WARN, "Timer arriving ", (ct - timerList.front().timeout).seconds(), " seconds late: ",
-                            *timerList.front().msg);
-                sendMessage(localAddress.getIPNum(), timerList.front().msg);
-                timerList.pop_front();
+        purgeCancelledTimers();
+        while (!timerHeap.empty()) {
+            SimTimer & first = timerHeap.front();
+            if (first.timeout <= ct) {
+                if (first.timeout < ct)
+                    Logger::msg("Sim.Progress", WARN, "Timer arriving ", (ct - first.timeout).seconds(), " seconds late: ",
+                            *first.msg);
+                sendMessage(localAddress.getIPNum(), first.msg);
+                liveTimers.erase(first.id);
+                std::pop_heap(timerHeap.begin(), timerHeap.end());
+                timerHeap.pop_back();
+                purgeCancelledTimers();
             } else {
-                if (!(timerList.front().id & 1)) {
+                if (!first.armed) {
                     // Program next timer
                     Simulator::getInstance().injectMessage(localAddress.getIPNum(), localAddress.getIPNum(), timerMsg,
-                            timerList.front().timeout - ct);
-                    ++timerList.front().id;
+                            first.timeout - ct);
+                    first.armed = true;
                 }
                 break;
             }
@@ -284,15 +313,15 @@ void StarsNode::fail() {
     if (!getSch().getTasks().empty())
         getSch().getTasks().front()->abort();
     // Remove timers not belonging to SubmissionNode
-    for (list<Timer>::iterator i = timerList.begin(); i != timerList.end();)
+    for (vector<SimTimer>::iterator i = timerHeap.begin(); i != timerHeap.end(); ++i)
         if (i->msg->getName() != "HeartbeatTimeout" && i->msg->getName() != "RequestTimeout")
-            i = timerList.erase(i);
-        else ++i;
+            liveTimers.erase(i->id);
     // Reset submission node, scheduler and dispatcher
     delete services[Disp];
     delete services[Sch];
     services[Sch] = Configuration::getInstance().getPolicy()->createScheduler(getLeaf());
     services[Disp] = Configuration::getInstance().getPolicy()->createDispatcher(getBranch());
+    updateRoutes();
 }
 
 
@@ -302,6 +331,7 @@ void StarsNode::createServices() {
     services.push_back(new SubmissionNode(getLeaf()));
     services.push_back(Configuration::getInstance().getPolicy()->createScheduler(getLeaf()));
     services.push_back(Configuration::getInstance().getPolicy()->createDispatcher(getBranch()));
+    updateRoutes();
 }
 
 
@@ -21,6 +21,8 @@
 #ifndef STARSNODE_H_
 #define STARSNODE_H_
 
+#include <vector>
+#include <unordered_set>
 #include <log4cpp/Priority.hh>
 #include <boost/filesystem/fstream.hpp>
 namespace fs = boost::filesystem;
@@ -131,11 +133,30 @@ private:
         Disp,
     };
 
+    /**
+     * A timer of a simulated node. Timers with the same timeout are delivered in reverse order of creation.
+     */
+    struct SimTimer : public Timer {
+        bool armed;   ///< True when a timer check event has been programmed for this timer
+
+        SimTimer(Time t, std::shared_ptr<BasicMsg> m) : Timer(t, m), armed(false) {}
+
+        /// Heap order, the top is the first timer to be delivered
+        bool operator<(const SimTimer & r) const {
+            return timeout > r.timeout || (timeout == r.timeout && id < r.id);
+        }
+    };
+
     friend class CommLayer;
+    int setSimTimer(Time time, std::shared_ptr<BasicMsg> msg);
+    void cancelSimTimer(int timerId);
+    void purgeCancelledTimers();
     void createServices();
     template <class T> void buildDispatcherGen();
     template <class T> void buildDispatcherDownGen();
 
+    std::vector<SimTimer> timerHeap;       ///< Heap of timers, cancelled ones included
+    std::unordered_set<int> liveTimers;    ///< IDs of the timers in the heap that are not cancelled
     SimAppDatabase db;
     stars::NetworkInterface iface;
     double power;
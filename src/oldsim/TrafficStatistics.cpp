@@ -18,11 +18,14 @@
  *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <sstream>
 #include <boost/filesystem/fstream.hpp>
 namespace fs = boost::filesystem;
 #include "Logger.hpp"
 #include "BasicMsg.hpp"
 #include "TaskStateChgMsg.hpp"
+#include "AvailabilityInformation.hpp"
+#include "AvailabilityDelta.hpp"
 #include "TrafficStatistics.hpp"
 #include "StructureNode.hpp"
 #include "StarsNode.hpp"
@@ -36,17 +39,47 @@ using namespace boost::posix_time;
 using std::static_pointer_cast;
 
 
-void TrafficStatistics::msgReceivedAtLevel(unsigned int level, unsigned int size, const std::string & name) {
+/// Returns the number of bytes that a value takes when it is packed
+template<class T> static unsigned int packedSize(const T & value) {
+    std::stringstream ss;
+    msgpack::packer<std::ostream> pk(&ss);
+    pk.pack(value);
+    return ss.tellp();
+}
+
+
+void TrafficStatistics::msgReceivedAtLevel(unsigned int level, unsigned int size, const BasicMsg & msg) {
     if (typeStatsPerLevel.size() <= level)
         typeStatsPerLevel.resize(level + 1);
-    typeStatsPerLevel[level][name].received.addMessage(size);
+    typeStatsPerLevel[level][msg.getName()].received.addMessage(size);
 }
 
 
-void TrafficStatistics::msgSentAtLevel(unsigned int level, unsigned int size, const std::string & name) {
+void TrafficStatistics::msgSentAtLevel(unsigned int level, unsigned int size, const BasicMsg & msg) {
     if (typeStatsPerLevel.size() <= level)
         typeStatsPerLevel.resize(level + 1);
+    std::string name = msg.getName();
     typeStatsPerLevel[level][name].sent.addMessage(size);
+    WireIdStats & ws = wireIdStats[name];
+    if (ws.numMessages++ == 0) {
+        ws.nameBytes = packedSize(name);
+        ws.idBytes = packedSize(msg.getWireId());
+    }
+    if (const AvailabilityDelta * delta = dynamic_cast<const AvailabilityDelta *>(&msg)) {
+        UpdateStats & us = updateStats[delta->getInfoName()];
+        us.numDeltas++;
+        us.fullBytes += delta->getFullSize();
+        us.sentBytes += msg.packedSize();
+    } else if (const AvailabilityInformation * info = dynamic_cast<const AvailabilityInformation *>(&msg)) {
+        // Only the updates between dispatchers can be sent as changes
+        if (!info->isFromSch()) {
+            UpdateStats & us = updateStats[name];
+            unsigned int bytes = msg.packedSize();
+            us.numFull++;
+            us.fullBytes += bytes;
+            us.sentBytes += bytes;
+        }
+    }
 }
 
 
@@ -78,6 +111,25 @@ void TrafficStatistics::saveTotalStatistics() {
     }
     os << endl << endl;
 
+    os << "# Bytes saved by sending type IDs instead of class names, by message type" << endl;
+    os << "# Msg name, sent msgs, name bytes, ID bytes, saved bytes per msg, total saved bytes" << endl;
+    for (auto & it : wireIdStats) {
+        WireIdStats & ws = it.second;
+        unsigned int saved = ws.nameBytes - ws.idBytes;
+        os << it.first << ',' << ws.numMessages << ',' << ws.nameBytes << ',' << ws.idBytes << ','
+                << saved << ',' << saved * ws.numMessages << endl;
+    }
+    os << endl << endl;
+
+    os << "# Bytes saved by sending availability updates as changes, by policy information" << endl;
+    os << "# Info name, whole updates, change updates, whole bytes, sent bytes, saved bytes, fr. saved" << endl;
+    for (auto & it : updateStats) {
+        UpdateStats & us = it.second;
+        os << it.first << ',' << us.numFull << ',' << us.numDeltas << ',' << us.fullBytes << ',' << us.sentBytes << ','
+                << us.fullBytes - us.sentBytes << ',' << (us.fullBytes ? 1.0 - (double)us.sentBytes / us.fullBytes : 0.0) << endl;
+    }
+    os << endl << endl;
+
 //    {
 //        // Data traffic mean
 //        double meanDataSent = 0.0, meanDataRecv = 0.0;
@@ -28,6 +28,7 @@
 #include <ostream>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "Time.hpp"
+#include "BasicMsg.hpp"
 
 class TrafficStatistics {
 
@@ -59,11 +60,29 @@ class TrafficStatistics {
 
     std::vector<std::map<std::string, LevelStats> > typeStatsPerLevel;
 
+    /// Bytes that a message type saves by sending its type ID instead of its class name
+    struct WireIdStats {
+        unsigned long int numMessages;
+        unsigned int nameBytes, idBytes;
+        WireIdStats() : numMessages(0), nameBytes(0), idBytes(0) {}
+    };
+
+    std::map<std::string, WireIdStats> wireIdStats;
+
+    /// Bytes of the availability updates between dispatchers, and of the whole information they replace
+    struct UpdateStats {
+        unsigned long int numFull, numDeltas;
+        unsigned long int fullBytes, sentBytes;
+        UpdateStats() : numFull(0), numDeltas(0), fullBytes(0), sentBytes(0) {}
+    };
+
+    std::map<std::string, UpdateStats> updateStats;
+
 public:
     void saveTotalStatistics();
 
-    void msgReceivedAtLevel(unsigned int level, unsigned int size, const std::string & name);
-    void msgSentAtLevel(unsigned int level, unsigned int size, const std::string & name);
+    void msgReceivedAtLevel(unsigned int level, unsigned int size, const BasicMsg & msg);
+    void msgSentAtLevel(unsigned int level, unsigned int size, const BasicMsg & msg);
 };
 
 #endif /*TRAFFICSTATISTICS_H_*/
@@ -39,7 +39,7 @@ template<> std::shared_ptr<IBPAvailabilityInformation> AggregationTestImpl<IBPAv
 
 
 template<> void AggregationTestImpl<IBPAvailabilityInformation>::computeResults(const std::shared_ptr<IBPAvailabilityInformation> & summary) {
-    list<IBPAvailabilityInformation::MDCluster *> clusters;
+    list<const IBPAvailabilityInformation::MDCluster *> clusters;
     TaskDescription dummy;
     dummy.setMaxMemory(0);
     dummy.setMaxDisk(0);
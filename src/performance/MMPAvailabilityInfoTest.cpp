@@ -51,7 +51,7 @@ template<> std::shared_ptr<MMPAvailabilityInformation> AggregationTestImpl<MMPAv
 
 
 template<> void AggregationTestImpl<MMPAvailabilityInformation>::computeResults(const std::shared_ptr<MMPAvailabilityInformation> & summary) {
-    list<MMPAvailabilityInformation::MDPTCluster *> clusters;
+    list<const MMPAvailabilityInformation::MDPTCluster *> clusters;
     TaskDescription dummy;
     dummy.setMaxMemory(0);
     dummy.setMaxDisk(0);
@@ -0,0 +1,78 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <array>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "FSPAvailabilityInformation.hpp"
+#include "FSPFunctionVector.hpp"
+#include "RandomQueueGenerator.hpp"
+using namespace std;
+using namespace stars;
+using namespace boost::posix_time;
+
+
+int main(int argc, char * argv[]) {
+    if (argc != 4) {
+        cout << "Usage: fsp-allocation num_tasks num_clusters iterations" << endl;
+        return 1;
+    }
+
+    unsigned int numTasks, numClusters, iterations;
+    istringstream(argv[1]) >> numTasks;
+    istringstream(argv[2]) >> numClusters;
+    istringstream(argv[3]) >> iterations;
+
+    // Two children with four nodes per cluster
+    RandomQueueGenerator gen(12345);
+    FSPAvailabilityInformation::setNumClusters(numClusters / 2);
+    FSPAvailabilityInformation info[2];
+    std::list<const FSPAvailabilityInformation::MDZCluster *> clusters[2];
+    array<double, 2> branchSlowness = {{0.0, 0.0}};
+    for (int c : {0, 1}) {
+        for (unsigned int i = 0; i < numClusters * 2; ++i) {
+            double power = gen.getRandomPower();
+            FSPTaskList proxys(gen.createRandomQueue(power));
+            FSPAvailabilityInformation node;
+            node.setAvailability(512 + i % 7 * 256, 1024 + i % 5 * 512, proxys, power);
+            if (i == 0) info[c].setAvailability(512, 1024, proxys, power);
+            else info[c].join(node);
+        }
+        info[c].reduce();
+        clusters[c] = info[c].getFunctions(TaskDescription());
+        branchSlowness[c] = info[c].getMinimumSlowness();
+    }
+    cout << "Allocating " << numTasks << " tasks to " << clusters[0].size() + clusters[1].size() << " clusters" << endl;
+
+    // The decisions are checked against the allocation with one heap per round in FSPAvailabilityInformationTest
+    cout << "# task length, us" << endl;
+    for (uint64_t a : {10000ULL, 100000ULL, 1000000ULL}) {
+        ptime start = microsec_clock::universal_time();
+        for (unsigned int i = 0; i < iterations; ++i) {
+            FSPDispatcher::FunctionVector functions(clusters, branchSlowness);
+            functions.computeTasksPerFunction(numTasks, a);
+        }
+        ptime end = microsec_clock::universal_time();
+        cout << a << ',' << (end - start).total_microseconds() / (double)iterations << endl;
+    }
+    return 0;
+}
@@ -40,18 +40,21 @@ int main(int argc, char * argv[]) {
     console->setLayout(l);
     Category::getRoot().addAppender(console);
 
-    if (argc != 5) {
-        cout << "Usage: fsp-clustering clusters distvecsize pieces reducquality" << endl;
+    if (argc != 5 && argc != 6) {
+        cout << "Usage: fsp-clustering clusters distvecsize pieces reducquality [threads]" << endl;
         return 1;
     }
 
-    unsigned int clusters, distvecsize, pieces, reducquality;
+    unsigned int clusters, distvecsize, pieces, reducquality, threads = 1;
     istringstream(argv[1]) >> clusters;
     istringstream(argv[2]) >> distvecsize;
     istringstream(argv[3]) >> pieces;
     istringstream(argv[4]) >> reducquality;
+    if (argc == 6)
+        istringstream(argv[5]) >> threads;
     stars::FSPAvailabilityInformation::setNumClusters(clusters);
     stars::ClusteringList<FSPAvailabilityInformation::MDZCluster>::setDistVectorSize(distvecsize);
+    stars::ClusteringList<FSPAvailabilityInformation::MDZCluster>::setNumThreads(threads);
     ZAFunction::setNumPieces(pieces);
     ZAFunction::setReductionQuality(reducquality);
 
@@ -67,10 +70,12 @@ int main(int argc, char * argv[]) {
         FSPAvailabilityInformation * fspai = static_cast<FSPAvailabilityInformation *>(BasicMsg::unpackMessage(pac));
         long int numClusters = fspai->getSummary().size();
         cout << "Reducing " << numClusters << " cluster: ";
+        unsigned long int allocations = ZAFunction::PieceVector::getHeapAllocations();
         ptime start = microsec_clock::local_time();
         fspai->reduce();
         ptime end = microsec_clock::local_time();
         long mus = (end - start).total_microseconds();
-        cout << mus << " us" << endl;
+        cout << mus << " us, " << ZAFunction::PieceVector::getHeapAllocations() - allocations
+                << " piece vectors spilled to the heap" << endl;
     }
 }
@@ -0,0 +1,78 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <log4cpp/Category.hh>
+#include <log4cpp/OstreamAppender.hh>
+#include "Logger.hpp"
+using namespace std;
+using namespace boost::posix_time;
+
+
+/// How Logger checked a category before handles were cached, for reference
+static bool uncachedCheck(const char * category, int priority) {
+    return log4cpp::Category::getInstance(category).isPriorityEnabled(priority);
+}
+
+
+template<class F> double callsPerSecond(unsigned long int numCalls, F f) {
+    ptime start = microsec_clock::universal_time();
+    for (unsigned long int i = 0; i < numCalls; ++i)
+        f(i);
+    ptime end = microsec_clock::universal_time();
+    return numCalls / ((end - start).total_microseconds() / 1000000.0);
+}
+
+
+int main(int argc, char * argv[]) {
+    unsigned long int numCalls = 10000000;
+    if (argc > 2) {
+        cout << "Usage: logger [num_calls]" << endl;
+        return 1;
+    } else if (argc == 2)
+        istringstream(argv[1]) >> numCalls;
+
+    Logger::initLog("root=WARN;Bench.Enabled=DEBUG");
+    // Enabled messages are formatted and appended, but the output is discarded
+    ofstream null("/dev/null");
+    log4cpp::Category & enabled = log4cpp::Category::getInstance("Bench.Enabled");
+    enabled.setAdditivity(false);
+    enabled.addAppender(new log4cpp::OstreamAppender("null", &null));
+
+    volatile bool sink;
+    double uncached = callsPerSecond(numCalls, [&](unsigned long int i) {
+        sink = uncachedCheck("Bench.Disabled", DEBUG);
+    });
+    double disabled = callsPerSecond(numCalls, [](unsigned long int i) {
+        Logger::msg("Bench.Disabled", DEBUG, "Message ", i, " with some values: ", i * 0.5);
+    });
+    // Enabled messages are much slower, do less of them
+    double enabledRate = callsPerSecond(numCalls / 100, [](unsigned long int i) {
+        Logger::msg("Bench.Enabled", DEBUG, "Message ", i, " with some values: ", i * 0.5);
+    });
+
+    cout << "Uncached category check: " << uncached << " calls/s" << endl;
+    cout << "Disabled log call: " << disabled << " calls/s" << endl;
+    cout << "Enabled log call: " << enabledRate << " calls/s" << endl;
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <list>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include "CommAddress.hpp"
+#include "BasicMsg.hpp"
+#include "util/MPSCQueue.hpp"
+using namespace std;
+using namespace boost::posix_time;
+
+
+class BenchMsg : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(BenchMsg);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+
+typedef std::pair<CommAddress, std::shared_ptr<BasicMsg> > AddrMsg;
+
+
+/// The queue that CommLayer used before MPSCQueue, for reference
+class LockedQueue {
+    std::list<AddrMsg> messageQueue;
+    boost::mutex queueMutex;
+    boost::condition nonEmptyQueue;
+
+public:
+    LockedQueue(size_t capacity) {}
+
+    void push(AddrMsg item) {
+        {
+            boost::mutex::scoped_lock lock(queueMutex);
+            messageQueue.push_back(item);
+        }
+        nonEmptyQueue.notify_all();
+    }
+
+    bool pop(AddrMsg & item, const std::atomic<bool> & cancel) {
+        boost::mutex::scoped_lock lock(queueMutex);
+        while (messageQueue.empty()) nonEmptyQueue.wait(lock);
+        item = messageQueue.front();
+        messageQueue.pop_front();
+        return true;
+    }
+};
+
+
+template <class Queue> double measure(unsigned int producers, unsigned long int messagesPerProducer, size_t capacity) {
+    Queue q(capacity);
+    std::atomic<bool> cancel(false);
+    std::shared_ptr<BasicMsg> msg(new BenchMsg);
+    CommAddress src("127.0.0.1", 2030);
+    std::vector<boost::thread *> threads;
+
+    ptime start = microsec_clock::universal_time();
+    for (unsigned int i = 0; i < producers; ++i)
+        threads.push_back(new boost::thread([&]() {
+            for (unsigned long int j = 0; j < messagesPerProducer; ++j)
+                q.push(AddrMsg(src, msg));
+        }));
+    AddrMsg item;
+    for (unsigned long int j = 0; j < producers * messagesPerProducer; ++j)
+        q.pop(item, cancel);
+    ptime end = microsec_clock::universal_time();
+
+    for (unsigned int i = 0; i < producers; ++i) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    return producers * messagesPerProducer / ((end - start).total_microseconds() / 1000000.0);
+}
+
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cout << "Usage: mpsc-queue messages_per_producer capacity" << endl;
+        return 1;
+    }
+
+    unsigned long int messages;
+    size_t capacity;
+    istringstream(argv[1]) >> messages;
+    istringstream(argv[2]) >> capacity;
+
+    cout << "# producers, MPSCQueue msg/s, locked list msg/s" << endl;
+    for (unsigned int producers = 1; producers <= 8; ++producers) {
+        double ringRate = measure<MPSCQueue<AddrMsg> >(producers, messages, capacity);
+        double listRate = measure<LockedQueue>(producers, messages, capacity);
+        cout << producers << ',' << ringRate << ',' << listRate << endl;
+    }
+
+    return 0;
+}
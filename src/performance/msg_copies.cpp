@@ -0,0 +1,163 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "FSPAvailabilityInformation.hpp"
+#include "RandomQueueGenerator.hpp"
+using namespace std;
+using namespace stars;
+using namespace boost::posix_time;
+namespace net = boost::asio;
+
+
+/*
+ * Both paths move a message from a sender to a receiver, with the socket replaced by a "wire" vector.
+ * Every buffer counts the bytes that are actually written to it, including the serialization itself
+ * and the receive into the first buffer, which the kernel does in a real socket. Copies made by a
+ * buffer when it grows are not counted, in either path.
+ */
+struct Result {
+    double microsPerMsg;
+    double copiesPerMsg;
+};
+
+
+/// An asio streambuf that counts the bytes written to it and read out of it
+class CountingStreambuf : public net::streambuf {
+public:
+    CountingStreambuf() : written(0), read(0) {}
+    unsigned long int written, read;
+
+protected:
+    std::streamsize xsputn(const char * s, std::streamsize n) {
+        std::streamsize result = net::streambuf::xsputn(s, n);
+        written += result;
+        return result;
+    }
+
+    std::streamsize xsgetn(char * s, std::streamsize n) {
+        std::streamsize result = net::streambuf::xsgetn(s, n);
+        read += result;
+        return result;
+    }
+};
+
+
+/// Path before zero-copy: packer over std::ostream into an asio streambuf, read into another streambuf and copied into the unpacker
+Result streambufPath(FSPAvailabilityInformation & info, unsigned int iterations) {
+    unsigned long int copiedBytes = 0, msgBytes = 0;
+    std::vector<char> wire;
+    ptime start = microsec_clock::universal_time();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        CountingStreambuf writeBuffer;
+        {
+            std::ostream os(&writeBuffer);
+            msgpack::packer<std::ostream> pk(&os);
+            info.pack(pk);
+        }
+        std::size_t size = writeBuffer.size();
+        msgBytes += size;
+        copiedBytes += writeBuffer.written;
+        wire.resize(size);
+        net::buffer_copy(net::buffer(wire), writeBuffer.data());
+        // Receiver
+        CountingStreambuf readBuffer;
+        std::size_t received = net::buffer_copy(readBuffer.prepare(size), net::buffer(wire));
+        readBuffer.commit(received);
+        copiedBytes += received;
+        msgpack::unpacker pac;
+        pac.reserve_buffer(size);
+        readBuffer.sgetn(pac.buffer(), size);
+        pac.buffer_consumed(readBuffer.read);
+        copiedBytes += readBuffer.read;
+        delete BasicMsg::unpackMessage(pac);
+    }
+    ptime end = microsec_clock::universal_time();
+    Result r = { (end - start).total_microseconds() / (double)iterations, copiedBytes / (double)msgBytes };
+    return r;
+}
+
+
+/// Zero-copy path: packer into an sbuffer that goes to the socket as is, read directly into the unpacker
+Result sbufferPath(FSPAvailabilityInformation & info, unsigned int iterations) {
+    unsigned long int copiedBytes = 0, msgBytes = 0;
+    std::vector<char> wire;
+    ptime start = microsec_clock::universal_time();
+    for (unsigned int i = 0; i < iterations; ++i) {
+        // An sbuffer only grows by appending, so its size is what the packer wrote to it
+        msgpack::sbuffer writeBuffer;
+        msgpack::packer<msgpack::sbuffer> pk(&writeBuffer);
+        info.pack(pk);
+        std::size_t size = writeBuffer.size();
+        msgBytes += size;
+        copiedBytes += writeBuffer.size();
+        wire.assign(writeBuffer.data(), writeBuffer.data() + size);
+        // Receiver, the unpacker buffer holds what the socket wrote to it
+        msgpack::unpacker pac;
+        pac.reserve_buffer(size);
+        std::memcpy(pac.buffer(), &wire[0], size);
+        pac.buffer_consumed(size);
+        copiedBytes += pac.nonparsed_size();
+        delete BasicMsg::unpackMessage(pac);
+    }
+    ptime end = microsec_clock::universal_time();
+    Result r = { (end - start).total_microseconds() / (double)iterations, copiedBytes / (double)msgBytes };
+    return r;
+}
+
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        cout << "Usage: msg-copies num_clusters iterations" << endl;
+        return 1;
+    }
+
+    unsigned int numClusters, iterations;
+    istringstream(argv[1]) >> numClusters;
+    istringstream(argv[2]) >> iterations;
+
+    // One cluster per node, without reduction
+    RandomQueueGenerator gen(12345);
+    FSPAvailabilityInformation info;
+    for (unsigned int i = 0; i < numClusters; ++i) {
+        double power = gen.getRandomPower();
+        FSPTaskList proxys(gen.createRandomQueue(power));
+        FSPAvailabilityInformation node;
+        node.setAvailability(512 + i % 7 * 256, 1024 + i % 5 * 512, proxys, power);
+        if (i == 0) info.setAvailability(512, 1024, proxys, power);
+        else info.join(node);
+    }
+    msgpack::sbuffer probe;
+    msgpack::packer<msgpack::sbuffer> pk(&probe);
+    info.pack(pk);
+    cout << "FSPAvailabilityInformation with " << info.getSummary().size() << " clusters, " << probe.size() << " bytes" << endl;
+
+    Result before = streambufPath(info, iterations);
+    Result after = sbufferPath(info, iterations);
+    cout << "# path, us/msg, user space copies/msg" << endl;
+    cout << "streambuf," << before.microsPerMsg << ',' << before.copiesPerMsg << endl;
+    cout << "sbuffer," << after.microsPerMsg << ',' << after.copiesPerMsg << endl;
+    return 0;
+}
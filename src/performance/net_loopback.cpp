@@ -0,0 +1,124 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include "CommLayer.hpp"
+#include "ConfigurationManager.hpp"
+using namespace std;
+using namespace boost::posix_time;
+
+
+class LoopbackMsg : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(LoopbackMsg);
+
+    std::vector<int32_t> payload;
+
+    MSGPACK_DEFINE(payload);
+};
+
+
+class LoopbackEnd : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(LoopbackEnd);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+REGISTER_MESSAGE(LoopbackMsg);
+REGISTER_MESSAGE(LoopbackEnd);
+
+
+class CountingService : public Service {
+public:
+    unsigned long int received;
+
+    CountingService() : received(0) {}
+
+    const HandlerTable * getHandlers() const {
+        static const HandlerTable handlers = HandlerTable()
+            .add<LoopbackMsg>(SERVICE_HANDLER(CountingService, LoopbackMsg))
+            .add<LoopbackEnd>(SERVICE_HANDLER(CountingService, LoopbackEnd));
+        return &handlers;
+    }
+
+    void handle(const CommAddress & src, const LoopbackMsg & msg) {
+        ++received;
+    }
+
+    void handle(const CommAddress & src, const LoopbackEnd & msg) {
+        CommLayer::getInstance().stopEventLoop();
+    }
+};
+
+
+int main(int argc, char * argv[]) {
+    if (argc < 3 || argc > 4) {
+        cout << "Usage: net-loopback num_messages payload_ints [port]" << endl;
+        return 1;
+    }
+
+    unsigned long int numMessages;
+    unsigned int payloadInts;
+    uint16_t port = 2030;
+    istringstream(argv[1]) >> numMessages;
+    istringstream(argv[2]) >> payloadInts;
+    if (argc == 4) istringstream(argv[3]) >> port;
+
+    ConfigurationManager::getInstance().setPort(port);
+    CommLayer & cl = CommLayer::getInstance();
+    cl.listen();
+    CountingService * s = new CountingService;
+    cl.registerService(s);
+    CommAddress self("127.0.0.1", port);
+    LoopbackMsg msg;
+    msg.payload.resize(payloadInts, 12345);
+
+    // The first message goes through a one-shot connection and tells the receiver that we understand type IDs
+    cl.sendMessage(self, msg.clone());
+    cl.processNextMessage();
+    s->received = 0;
+
+    unsigned long int sent = 0, bytes = 0;
+    ptime start = microsec_clock::universal_time();
+    boost::thread sender([&]() {
+        for (unsigned long int i = 0; i < numMessages; ++i) {
+            unsigned int size = cl.sendMessage(self, msg.clone());
+            if (size) {
+                ++sent;
+                bytes += size;
+            }
+        }
+        // Messages are delivered in order, so this one arrives the last
+        while (!cl.sendMessage(self, new LoopbackEnd));
+    });
+    cl.commEventLoop();
+    ptime end = microsec_clock::universal_time();
+    sender.join();
+
+    double seconds = (end - start).total_microseconds() / 1000000.0;
+    cout << "Sent " << sent << " of " << numMessages << " messages, received " << s->received << endl;
+    cout << "Throughput: " << s->received / seconds << " msg/s, " << bytes / seconds / 1048576.0 << " MiB/s" << endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "TimerQueue.hpp"
+using namespace std;
+using namespace boost::posix_time;
+
+
+class BenchTimer : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(BenchTimer);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+
+int main(int argc, char * argv[]) {
+    unsigned int numTimers = 1000000;
+    if (argc > 2) {
+        cout << "Usage: timer-queue [num_timers]" << endl;
+        return 1;
+    } else if (argc == 2)
+        istringstream(argv[1]) >> numTimers;
+
+    std::mt19937 gen(12345);
+    // Timeouts in the next hour, with microsecond resolution
+    std::uniform_int_distribution<int64_t> timeout(0, 3600000000LL);
+    std::shared_ptr<BasicMsg> msg(new BenchTimer);
+    TimerQueue q;
+    std::vector<int> ids;
+    ids.reserve(numTimers);
+
+    // Arm and cancel in random order
+    ptime start = microsec_clock::local_time();
+    for (unsigned int i = 0; i < numTimers; ++i) {
+        TimerQueue::Timer t(Time(timeout(gen)), msg);
+        q.push(t);
+        ids.push_back(t.id);
+    }
+    ptime armEnd = microsec_clock::local_time();
+    std::shuffle(ids.begin(), ids.end(), gen);
+    ptime cancelStart = microsec_clock::local_time();
+    for (unsigned int i = 0; i < numTimers; ++i)
+        q.cancel(ids[i]);
+    ptime end = microsec_clock::local_time();
+    cout << "Arm " << numTimers << " timers: " << (armEnd - start).total_microseconds() << " us" << endl;
+    cout << "Cancel " << numTimers << " timers: " << (end - cancelStart).total_microseconds() << " us" << endl;
+
+    // Arm and expire in timeout order
+    start = microsec_clock::local_time();
+    for (unsigned int i = 0; i < numTimers; ++i)
+        q.push(TimerQueue::Timer(Time(timeout(gen)), msg));
+    armEnd = microsec_clock::local_time();
+    while (!q.empty())
+        q.pop();
+    end = microsec_clock::local_time();
+    cout << "Arm " << numTimers << " timers: " << (armEnd - start).total_microseconds() << " us" << endl;
+    cout << "Expire " << numTimers << " timers: " << (end - armEnd).total_microseconds() << " us" << endl;
+
+    return 0;
+}
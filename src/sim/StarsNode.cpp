@@ -19,6 +19,7 @@
  */
 
 #include <sstream>
+#include <cassert>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include "StarsNode.hpp"
@@ -74,7 +75,8 @@ Scheduler::ExecutionEnvironmentImpl::ExecutionEnvironmentImpl()
 
 
 // CommLayer
-CommLayer::CommLayer() : exitSignaled(false) {}
+CommLayer::CommLayer() : messageQueue(defaultQueueCapacity), exitSignaled(false),
+        measuring(false), statsPeriod(0), nextSnapshot(0) {}
 
 
 // The following functions must allways be called from an agent's thread
@@ -112,8 +114,7 @@ Time Time::getCurrentTime() {
 int CommLayer::setTimerImpl(Time time, shared_ptr<BasicMsg> msg) {
     // Add a task to the timer structure
     Timer t(time, msg);
-    timerList.push_front(t);
-    timerList.sort();
+    timers.push(t);
     return t.id;
 }
 
@@ -161,6 +162,8 @@ void StarsNode::Configuration::setup(const Properties & property) {
 void StarsNode::libStarsConfigure(const Properties & property) {
     ConfigurationManager::getInstance().setUpdateBandwidth(property("update_bw", 1000.0));
     ConfigurationManager::getInstance().setSlownessRatio(property("stretch_ratio", 2.0));
+    ConfigurationManager::getInstance().setIncrementalReductions(property("incremental_reductions", 16U));
+    ConfigurationManager::getInstance().setDeltaUpdates(property("delta_updates", 8U));
     ConfigurationManager::getInstance().setHeartbeat(property("heartbeat", 300));
     ConfigurationManager::getInstance().setSubmitRetries(property("submit_retries", 3));
     ConfigurationManager::getInstance().setWorkingPath(Simulator::getInstance().getResultDir());
@@ -221,7 +224,7 @@ int StarsNode::mainLoop() {
     while(sim.doContinue()) {
         // Event loop: receive messages from the simulator and treat them
         m_task_t task = NULL;
-        double timeout = timerList.empty() ? 1000.0 : (timerList.front().timeout - Time::getCurrentTime()).seconds();
+        double timeout = timers.empty() ? 1000.0 : (timers.top().timeout - Time::getCurrentTime()).seconds();
         msg_comm_t comm = MSG_task_irecv(&task, mailbox.c_str());
         if (MSG_comm_wait(comm, timeout) == MSG_OK) {
             MSG_comm_destroy(comm);
@@ -233,17 +236,18 @@ int StarsNode::mainLoop() {
             MSG_comm_destroy(comm);
             // Check timers
             Time ct = Time::getCurrentTime();
-            while (!timerList.empty() && timerList.front().timeout <= ct) {
-                enqueueMessage(localAddress, timerList.front().msg);
-                timerList.pop_front();
+            while (!timers.empty() && timers.top().timeout <= ct) {
+                enqueueMessage(localAddress, timers.top().msg);
+                timers.pop();
             }
         }
-        while (!messageQueue.empty()) {
-            std::shared_ptr<BasicMsg> msg = messageQueue.front().second;
-            CommAddress dst = messageQueue.front().first;
+        QueuedMsg next;
+        while (messageQueue.tryPop(next)) {
+            std::shared_ptr<BasicMsg> msg = next.msg;
+            CommAddress dst = next.src;
             sim.getCase().beforeEvent(localAddress, dst, msg);
             sim.getPerformanceStatistics().startEvent(msg->getName());
-            processNextMessage();
+            handleMessage(dst, msg);
             sim.getPerformanceStatistics().endEvent(msg->getName());
             sim.getCase().afterEvent(localAddress, dst, msg);
         }
@@ -423,10 +427,15 @@ unsigned int StarsNode::getBranchLevel() const {
 
 
 unsigned long int StarsNode::getMsgSize(BasicMsg * msg) {
-    ostringstream oss;
-    msgpack::packer<std::ostream> pk(&oss);
+    unsigned long int size = msg->packedSize();
+#ifndef NDEBUG
+    // Check it against the actual serialization
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> pk(&buffer);
     msg->pack(pk);
-    return oss.tellp();
+    assert(size == buffer.size());
+#endif
+    return size;
 }
 
 
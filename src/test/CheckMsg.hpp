@@ -42,6 +42,7 @@ public:
         out->pack(pk);
         unsigned int size = ss.tellp();
         BOOST_TEST_MESSAGE(msg.getName() << " of size " << size << " bytes.");
+        BOOST_CHECK_EQUAL(out->packedSize(), size);
         msgpack::unpacker pac;
         pac.reserve_buffer(size);
         ss.readsome(pac.buffer(), size);
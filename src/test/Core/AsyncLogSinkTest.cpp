@@ -0,0 +1,124 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "AsyncLogSink.hpp"
+#include "Logger.hpp"
+#include "TestHost.hpp"
+using namespace std;
+namespace fs = boost::filesystem;
+
+
+/// Reads the messages of the records in a log file
+static vector<string> readMessages(const fs::path & file) {
+    vector<string> result;
+    fs::ifstream in(file);
+    string line;
+    while (getline(in, line)) {
+        size_t pos = line.find(" : ");
+        if (pos != string::npos) result.push_back(line.substr(pos + 3));
+    }
+    return result;
+}
+
+
+BOOST_AUTO_TEST_SUITE(Cor)   // Correctness test suite
+
+BOOST_AUTO_TEST_SUITE(AsyncLog)
+
+/// Every record is written when the sink stops, in the order each thread appended it
+BOOST_AUTO_TEST_CASE(asyncLogBlock) {
+    TestHost::getInstance().reset();
+    fs::path file = fs::temp_directory_path() / fs::unique_path();
+    const string category("Test.AsyncLog");
+    const unsigned int numThreads = 4, numRecords = 10000;
+    {
+        // A small buffer, so that threads have to wait
+        AsyncLogSink sink(file, 16, AsyncLogSink::BLOCK);
+        boost::thread_group threads;
+        for (unsigned int t = 0; t < numThreads; ++t)
+            threads.create_thread([&, t]() {
+                for (unsigned int i = 0; i < numRecords; ++i) {
+                    ostringstream oss;
+                    oss << t << ' ' << i;
+                    sink.append(category, INFO, oss.str());
+                }
+            });
+        threads.join_all();
+        sink.stop();
+        BOOST_CHECK_EQUAL(sink.getDropped(), 0);
+    }
+    vector<string> messages = readMessages(file);
+    BOOST_REQUIRE_EQUAL(messages.size(), numThreads * numRecords);
+    vector<unsigned int> next(numThreads, 0);
+    for (auto & m : messages) {
+        unsigned int t, i;
+        istringstream(m) >> t >> i;
+        BOOST_REQUIRE_LT(t, numThreads);
+        BOOST_CHECK_EQUAL(i, next[t]++);
+    }
+    fs::remove(file);
+}
+
+
+/// Records that do not fit are counted, and the rest are written
+BOOST_AUTO_TEST_CASE(asyncLogDrop) {
+    TestHost::getInstance().reset();
+    fs::path file = fs::temp_directory_path() / fs::unique_path();
+    const string category("Test.AsyncLog");
+    const unsigned int numRecords = 1000;
+    unsigned long int dropped;
+    {
+        // A long period, so that the buffer fills up before it is drained
+        AsyncLogSink sink(file, 8, AsyncLogSink::DROP, Duration(60.0));
+        for (unsigned int i = 0; i < numRecords; ++i)
+            sink.append(category, INFO, "record");
+        sink.stop();
+        dropped = sink.getDropped();
+        sink.append(category, INFO, "after stop");
+        BOOST_CHECK_EQUAL(sink.getDropped(), dropped + 1);
+    }
+    BOOST_CHECK_GT(dropped, 0);
+    // Dropped records are reported in the file, maybe in several batches
+    unsigned long int written = 0, reported = 0;
+    for (auto & m : readMessages(file)) {
+        if (m == "record") ++written;
+        else {
+            unsigned long int n;
+            string rest;
+            istringstream(m) >> n >> rest;
+            BOOST_CHECK_EQUAL(rest, "records");
+            reported += n;
+        }
+    }
+    BOOST_CHECK_EQUAL(reported, dropped);
+    BOOST_CHECK_EQUAL(written, numRecords - dropped);
+    fs::remove(file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()   // AsyncLog
+
+BOOST_AUTO_TEST_SUITE_END()   // Cor
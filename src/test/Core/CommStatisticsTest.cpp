@@ -0,0 +1,209 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include "CommLayer.hpp"
+#include "CommStatistics.hpp"
+#include "TestHost.hpp"
+using namespace std;
+namespace fs = boost::filesystem;
+
+
+class StatsPing : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(StatsPing);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+
+class StatsPong : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(StatsPong);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+
+class StatsNoop : public BasicMsg {
+public:
+    MESSAGE_SUBCLASS(StatsNoop);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
+REGISTER_MESSAGE(StatsPing);
+REGISTER_MESSAGE(StatsPong);
+REGISTER_MESSAGE(StatsNoop);
+
+
+// A service that handles pings and pongs through a handler table
+class StatsCounter : public Service {
+public:
+    unsigned int received;
+
+    StatsCounter() : received(0) {}
+
+    const HandlerTable * getHandlers() const {
+        static const HandlerTable handlers = HandlerTable()
+            .add<StatsPing>(SERVICE_HANDLER(StatsCounter, StatsPing))
+            .add<StatsPong>(SERVICE_HANDLER(StatsCounter, StatsPong));
+        return &handlers;
+    }
+
+    void handle(const CommAddress & src, const StatsPing & msg) {
+        ++received;
+    }
+
+    void handle(const CommAddress & src, const StatsPong & msg) {
+        ++received;
+    }
+};
+
+
+// A service that sees every message
+class StatsObserver : public Service {
+public:
+    bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
+        return false;
+    }
+};
+
+
+/// Returns the count of the line that starts with a name in a statistics file, or -1 if there is none
+static long int readCount(const fs::path & file, const string & name) {
+    fs::ifstream in(file);
+    string line;
+    while (getline(in, line))
+        if (line.compare(0, name.size() + 1, name + ",") == 0) {
+            size_t end = line.find(',', name.size() + 1);
+            return atol(line.substr(name.size() + 1, end - name.size() - 1).c_str());
+        }
+    return -1;
+}
+
+
+BOOST_AUTO_TEST_SUITE(Cor)   // Correctness test suite
+
+BOOST_AUTO_TEST_SUITE(CommStats)
+
+/// Every value falls in a bucket whose width is at most an eighth of its lower bound
+BOOST_AUTO_TEST_CASE(commStatsHistogram) {
+    for (unsigned int b = 1; b < LatencyHistogram::numBuckets; ++b) {
+        BOOST_REQUIRE_EQUAL(LatencyHistogram::lowerBound(b), LatencyHistogram::upperBound(b - 1) + 1);
+        BOOST_REQUIRE_EQUAL(LatencyHistogram::bucketOf(LatencyHistogram::lowerBound(b)), b);
+    }
+    BOOST_CHECK_EQUAL(LatencyHistogram::bucketOf(UINT64_MAX), LatencyHistogram::numBuckets - 1);
+
+    boost::random::mt19937 gen(1234);
+    for (int i = 0; i < 10000; ++i) {
+        uint64_t v = boost::random::uniform_int_distribution<uint64_t>(0, UINT64_MAX >> (i % 64))(gen);
+        unsigned int b = LatencyHistogram::bucketOf(v);
+        BOOST_REQUIRE(LatencyHistogram::lowerBound(b) <= v && v <= LatencyHistogram::upperBound(b));
+        BOOST_REQUIRE(LatencyHistogram::upperBound(b) - LatencyHistogram::lowerBound(b) <= LatencyHistogram::lowerBound(b) / 8);
+    }
+
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 1000; ++v) h.record(v);
+    BOOST_CHECK_EQUAL(h.getCount(), 1000U);
+    BOOST_CHECK_EQUAL(h.getSum(), 500500U);
+    BOOST_CHECK_EQUAL(h.getMax(), 1000U);
+    BOOST_CHECK(h.getPercentile(0.5) >= 500 && h.getPercentile(0.5) <= 500 + 500 / 8);
+    BOOST_CHECK(h.getPercentile(0.99) >= 990 && h.getPercentile(0.99) <= 1000);
+    BOOST_CHECK_EQUAL(h.getPercentile(1.0), 1000U);
+    h.clear();
+    BOOST_CHECK_EQUAL(h.getCount(), 0U);
+    BOOST_CHECK_EQUAL(h.getPercentile(0.5), 0U);
+}
+
+/// The counters of each message type and service match a synthetic message stream
+BOOST_AUTO_TEST_CASE(commStatsCounts) {
+    TestHost::getInstance().reset();
+    CommLayer & cl = CommLayer::getInstance();
+    BOOST_CHECK(cl.getStatistics() == NULL);
+    StatsObserver * observer = new StatsObserver;
+    cl.registerService(observer);
+    StatsCounter * counter = new StatsCounter;
+    cl.registerService(counter);
+    fs::path file = fs::temp_directory_path() / fs::unique_path();
+    cl.enableStatistics(file.string(), Duration(3600.0));
+
+    boost::random::mt19937 gen(5678);
+    boost::random::uniform_int_distribution<int> kind(0, 2);
+    unsigned int sent[3] = {0, 0, 0};
+    for (int i = 0; i < 1000; ++i) {
+        int k = kind(gen);
+        ++sent[k];
+        if (k == 0) cl.sendLocalMessage(new StatsPing);
+        else if (k == 1) cl.sendLocalMessage(new StatsPong);
+        else cl.sendLocalMessage(new StatsNoop);
+        // Let some messages wait in the queue
+        if (i % 3 == 2)
+            while (cl.availableMessages()) cl.processNextMessage();
+    }
+    while (cl.availableMessages()) cl.processNextMessage();
+
+    const CommStatistics * stats = cl.getStatistics();
+    BOOST_REQUIRE(stats != NULL);
+    unsigned int types[3] = {StatsPing::typeIndex(), StatsPong::typeIndex(), StatsNoop::typeIndex()};
+    for (int k = 0; k < 3; ++k) {
+        const CommStatistics::TypeStats * ts = stats->getTypeStats(types[k]);
+        BOOST_REQUIRE(ts != NULL);
+        BOOST_CHECK_EQUAL(ts->handlerTime.getCount(), sent[k]);
+        BOOST_CHECK_EQUAL(ts->queueDelay.getCount(), sent[k]);
+    }
+    BOOST_CHECK_EQUAL(counter->received, sent[0] + sent[1]);
+    BOOST_CHECK_EQUAL(stats->getServiceStats(0).handlerTime.getCount(), sent[0] + sent[1] + sent[2]);
+    BOOST_CHECK_EQUAL(stats->getServiceStats(1).handlerTime.getCount(), sent[0] + sent[1]);
+    BOOST_CHECK_EQUAL(stats->getServiceStats(1).name, "StatsCounter");
+
+    // The counter keeps its statistics when it moves to the first position
+    cl.unregisterService(observer);
+    cl.sendLocalMessage(new StatsPing);
+    cl.processNextMessage();
+    BOOST_CHECK_EQUAL(stats->getServiceStats(0).handlerTime.getCount(), sent[0] + sent[1] + 1);
+
+    // The last snapshot is written when statistics are disabled
+    cl.disableStatistics();
+    BOOST_CHECK(cl.getStatistics() == NULL);
+    BOOST_CHECK_EQUAL(readCount(file, "StatsPing"), (long int)sent[0] + 1);
+    BOOST_CHECK_EQUAL(readCount(file, "StatsPong"), (long int)sent[1]);
+    BOOST_CHECK_EQUAL(readCount(file, "StatsNoop"), (long int)sent[2]);
+    BOOST_CHECK_EQUAL(readCount(file, "StatsCounter"), (long int)(sent[0] + sent[1] + 1));
+    BOOST_CHECK_EQUAL(readCount(file, "StatsObserver (unregistered)"), (long int)(sent[0] + sent[1] + sent[2]));
+    fs::remove(file);
+
+    // Snapshots are written periodically while messages arrive
+    cl.enableStatistics(file.string(), Duration(0.0));
+    cl.sendLocalMessage(new StatsPong);
+    cl.processNextMessage();
+    BOOST_CHECK_EQUAL(readCount(file, "StatsPong"), 1);
+    cl.disableStatistics();
+    fs::remove(file);
+}
+
+BOOST_AUTO_TEST_SUITE_END()   // CommStats
+
+BOOST_AUTO_TEST_SUITE_END()   // Cor
@@ -57,19 +57,26 @@ public:
     EMPTY_MSGPACK_DEFINE();
 };
 
+class LoudPing : public Ping {
+public:
+    MESSAGE_SUBCLASS(LoudPing);
+
+    EMPTY_MSGPACK_DEFINE();
+};
+
 REGISTER_MESSAGE(Ping);
 REGISTER_MESSAGE(Pong);
+REGISTER_MESSAGE(LoudPing);
 
 
 // A service that does pings
 class PingService : public Service {
 public:
 
-    bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
-        if (typeid(msg) == typeid(Ping)) {
-            handle(src, static_cast<const Ping &>(msg));
-            return true;
-        } else return false;
+    const HandlerTable * getHandlers() const {
+        static const HandlerTable handlers = HandlerTable()
+            .add<Ping>(SERVICE_HANDLER(PingService, Ping));
+        return &handlers;
     }
 
     void handle(const CommAddress & src, const Ping & msg) {
@@ -113,6 +120,44 @@ public:
 };
 
 
+// A service that counts the messages it receives through a handler table
+class CountingService : public Service {
+public:
+    unsigned int pings, pongs;
+
+    CountingService() : pings(0), pongs(0) {}
+
+    const HandlerTable * getHandlers() const {
+        static const HandlerTable handlers = HandlerTable()
+            .addFamily<Ping>(SERVICE_HANDLER(CountingService, Ping))
+            .add<Pong>(SERVICE_HANDLER(CountingService, Pong));
+        return &handlers;
+    }
+
+    void handle(const CommAddress & src, const Ping & msg) {
+        ++pings;
+    }
+
+    void handle(const CommAddress & src, const Pong & msg) {
+        ++pongs;
+    }
+};
+
+
+// A service without handler table, which sees every message
+class CatchAllService : public Service {
+public:
+    unsigned int received;
+
+    CatchAllService() : received(0) {}
+
+    bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
+        ++received;
+        return false;
+    }
+};
+
+
 /// Test cases
 BOOST_AUTO_TEST_SUITE(Cor)   // Correctness test suite
 
@@ -153,6 +198,36 @@ BOOST_AUTO_TEST_CASE(testCommLayerLocal) {
     BOOST_CHECK(s2->isPinged());
 }
 
+BOOST_AUTO_TEST_CASE(testCommLayerRouting) {
+    TestHost::getInstance().reset();
+    ConfigurationManager::getInstance().setPort(2030);
+
+    CountingService * s1 = new CountingService;
+    CommLayer::getInstance().registerService(s1);
+    CatchAllService * s2 = new CatchAllService;
+    CommLayer::getInstance().registerService(s2);
+
+    // Exact types and registered subclasses go through the table, the catch-all service sees everything
+    CommLayer::getInstance().sendLocalMessage(new Ping);
+    CommLayer::getInstance().sendLocalMessage(new LoudPing);
+    CommLayer::getInstance().sendLocalMessage(new Pong);
+    for (int i = 0; i < 3; ++i)
+        CommLayer::getInstance().processNextMessage();
+    BOOST_CHECK_EQUAL(s1->pings, 2U);
+    BOOST_CHECK_EQUAL(s1->pongs, 1U);
+    BOOST_CHECK_EQUAL(s2->received, 3U);
+
+    // Routes are rebuilt when a service leaves
+    CommLayer::getInstance().unregisterService(s2);
+    CommLayer::getInstance().sendLocalMessage(new Pong);
+    CommLayer::getInstance().processNextMessage();
+    BOOST_CHECK_EQUAL(s1->pongs, 2U);
+
+    // A direct call uses the same table
+    BOOST_CHECK(s1->receiveMessage(CommLayer::getInstance().getLocalAddress(), LoudPing()));
+    BOOST_CHECK_EQUAL(s1->pings, 3U);
+}
+
 void pingThread() {
     TestHost::getInstance().addSingleton();
     ConfigurationManager::getInstance().setPort(2040);
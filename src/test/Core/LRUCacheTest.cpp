@@ -0,0 +1,95 @@
+/*
+ *  STaRS, Scalable Task Routing approach to distributed Scheduling
+ *  Copyright (C) 2012 Javier Celaya
+ *
+ *  This file is part of STaRS.
+ *
+ *  STaRS is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  STaRS is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with STaRS; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "util/LRUCache.hpp"
+#include "TestHost.hpp"
+
+
+BOOST_AUTO_TEST_SUITE(Cor)   // Correctness test suite
+
+BOOST_AUTO_TEST_SUITE(LRUCacheTS)
+
+/// A key seen again is a hit, and becomes the most recent one
+BOOST_AUTO_TEST_CASE(lruCacheHit) {
+    TestHost::getInstance().reset();
+    Time now = Time::getCurrentTime();
+    LRUCache<int> cache(3, Duration(10.0));
+    BOOST_CHECK(cache.empty());
+    BOOST_CHECK(!cache.touch(1, now));
+    BOOST_CHECK(!cache.touch(2, now));
+    BOOST_CHECK(cache.touch(1, now));
+    BOOST_CHECK(cache.touch(2, now));
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+    cache.clear();
+    BOOST_CHECK(cache.empty());
+    BOOST_CHECK(!cache.touch(1, now));
+}
+
+
+/// When the cache is full, the least recently seen key is evicted
+BOOST_AUTO_TEST_CASE(lruCacheEviction) {
+    TestHost::getInstance().reset();
+    Time now = Time::getCurrentTime();
+    LRUCache<int> cache(3, Duration(10.0));
+    for (int i = 1; i <= 3; ++i)
+        BOOST_CHECK(!cache.touch(i, now));
+    // Refresh 1, so that 2 is the oldest one
+    BOOST_CHECK(cache.touch(1, now));
+    BOOST_CHECK(!cache.touch(4, now));
+    BOOST_CHECK_EQUAL(cache.size(), 3);
+    // 2 was evicted and evicts 3 when it comes back
+    BOOST_CHECK(!cache.touch(2, now));
+    BOOST_CHECK_EQUAL(cache.size(), 3);
+    BOOST_CHECK(cache.touch(4, now));
+    BOOST_CHECK(cache.touch(1, now));
+    BOOST_CHECK(!cache.touch(3, now));
+    // Order is now 3, 1, 4, 2 from newest to oldest, and 2 is evicted
+    BOOST_CHECK(cache.touch(4, now));
+    BOOST_CHECK(cache.touch(1, now));
+    BOOST_CHECK(cache.touch(3, now));
+}
+
+
+/// Keys not seen for longer than the maximum age are expired
+BOOST_AUTO_TEST_CASE(lruCacheExpiry) {
+    TestHost::getInstance().reset();
+    Time now = Time::getCurrentTime();
+    LRUCache<int> cache(10, Duration(10.0));
+    cache.touch(1, now);
+    cache.touch(2, now + Duration(4.0));
+    cache.touch(3, now + Duration(8.0));
+    // Seeing 1 again refreshes its age
+    BOOST_CHECK(cache.touch(1, now + Duration(9.0)));
+    cache.expire(now + Duration(10.0));
+    BOOST_CHECK_EQUAL(cache.size(), 3);
+    // Only 2 has not been seen for more than 10 seconds
+    cache.expire(now + Duration(15.0));
+    BOOST_CHECK_EQUAL(cache.size(), 2);
+    BOOST_CHECK(cache.touch(3, now + Duration(15.0)));
+    BOOST_CHECK(!cache.touch(2, now + Duration(15.0)));
+    // touch() expires before looking the key up
+    BOOST_CHECK(!cache.touch(1, now + Duration(30.0)));
+    BOOST_CHECK_EQUAL(cache.size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()   // LRUCacheTS
+
+BOOST_AUTO_TEST_SUITE_END()   // Cor
@@ -20,6 +20,8 @@
 
 #include <boost/test/unit_test.hpp>
 #include <cmath>
+#include <memory>
+#include <cstring>
 #include "Logger.hpp"
 #include "SerializableBatch.hpp"
 using namespace std;
@@ -52,6 +54,28 @@ BOOST_AUTO_TEST_CASE(testSerializable) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(testWireIdFallback) {
+    // Messages from peers that do not know type IDs carry the class name
+    for (int withName = 0; withName < 2; withName++) {
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> pk(&buffer);
+        SerializableBatch a;
+        if (withName) a.packWithName(pk);
+        else a.pack(pk);
+        msgpack::unpacker pac;
+        pac.reserve_buffer(buffer.size());
+        memcpy(pac.buffer(), buffer.data(), buffer.size());
+        pac.buffer_consumed(buffer.size());
+        bool withId;
+        std::unique_ptr<BasicMsg> c(BasicMsg::unpackMessage(pac, &withId));
+        BOOST_CHECK_EQUAL(withId, !withName);
+        SerializableBatch * b = dynamic_cast<SerializableBatch *>(c.get());
+        BOOST_REQUIRE(b);
+        BOOST_CHECK(a == *b);
+    }
+    BOOST_CHECK_EQUAL(SerializableBatch::wireId(), BasicMsg::wireIdOf("SerializableBatch"));
+}
+
 BOOST_AUTO_TEST_SUITE_END()   // Srlz
 
 BOOST_AUTO_TEST_SUITE_END()   // Cor
@@ -104,7 +104,7 @@ bool init_unit_test_suite() {
         Logger::initLog(line);
     }
     // Test log priority is always DEBUG
-    Category::getInstance("Test").setPriority(DEBUG);
+    Logger::initLog("Test=DEBUG");
 
     TestAppender * console = new TestAppender("ConsoleAppender");
     log4cpp::PatternLayout * layout = new log4cpp::PatternLayout();
@@ -44,6 +44,42 @@ BOOST_AUTO_TEST_CASE(DPAvailabilityInformationTest_checkMsg) {
     CheckMsgMethod::check(e, p);
 }
 
+
+/// Assignment of tasks to several clusters at once
+BOOST_AUTO_TEST_CASE(DPAvailabilityInformationTest_updateSeveralClusters) {
+    TestHost::getInstance().reset();
+    Time ct = Time::getCurrentTime();
+    list<std::shared_ptr<Task> > emptyQueue;
+    DPAvailabilityInformation info;
+    const unsigned int numNodes = 4;
+    for (unsigned int i = 0; i < numNodes; ++i)
+        info.addNode(1024 * (i + 1), 1024 * (i + 1), 1000.0, emptyQueue);
+
+    TaskDescription req;
+    req.setLength(10000);
+    req.setNumTasks(numNodes);
+    req.setMaxMemory(512);
+    req.setMaxDisk(512);
+    req.setDeadline(ct + Duration(15.0));
+    list<DPAvailabilityInformation::AssignmentInfo> ai;
+    info.getAvailability(ai, req);
+    BOOST_REQUIRE_EQUAL(ai.size(), numNodes);
+    for (auto & i : ai)
+        i.numTasks = 1;
+
+    // The new clusters are appended after the assigned ones, without invalidating them
+    info.update(ai, req);
+    const stars::ClusteringList<DPAvailabilityInformation::MDFCluster> & summary = info.getSummary();
+    BOOST_REQUIRE_EQUAL(summary.size(), 2 * numNodes);
+    for (unsigned int i = 0; i < numNodes; ++i) {
+        BOOST_CHECK_EQUAL(summary[i].value, 0);
+        BOOST_CHECK_EQUAL(summary[numNodes + i].value, 1);
+        BOOST_CHECK_EQUAL(summary[numNodes + i].minM, summary[i].minM);
+        BOOST_CHECK_LT(summary[numNodes + i].minA.getAvailabilityBefore(req.getDeadline()),
+                summary[i].minA.getAvailabilityBefore(req.getDeadline()));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()   // aiTS
 
 BOOST_AUTO_TEST_SUITE_END()   // Cor
@@ -22,10 +22,57 @@
 #include "CommLayer.hpp"
 #include "StructureNode.hpp"
 #include "TaskBagMsg.hpp"
+#include "TestHost.hpp"
+#include "IBPDispatcher.hpp"
 using namespace std;
 using namespace boost;
 using namespace boost::posix_time;
 
+
+/// A branch with fixed addresses, whose children are leaves
+class FixedBranch : public OverlayBranch {
+public:
+    FixedBranch(const CommAddress & f, const CommAddress & l, const CommAddress & r) : father(f) {
+        child[0] = l;
+        child[1] = r;
+    }
+    bool inNetwork() const { return true; }
+    const CommAddress & getFatherAddress() const { return father; }
+    const CommAddress & getChildAddress(int c) const { return child[c]; }
+    double getChildDistance(int c, const CommAddress & src) const { return 0.0; }
+    bool isLeaf(int c) const { return true; }
+private:
+    CommAddress father, child[2];
+};
+
+
+/// A dispatcher whose messages are handled directly by the test
+class TestDispatcher : public IBPDispatcher {
+public:
+    TestDispatcher(OverlayBranch & b) : IBPDispatcher(b) {}
+    using Dispatcher<IBPAvailabilityInformation>::handle;
+};
+
+
+/// Keeps the messages sent to the local address
+class MessageSink : public Service {
+public:
+    std::vector<std::shared_ptr<BasicMsg> > msgs;
+    bool receiveMessage(const CommAddress & src, const BasicMsg & msg) {
+        msgs.push_back(std::shared_ptr<BasicMsg>(msg.clone()));
+        return true;
+    }
+};
+
+
+/// Delivers the queued messages, and returns the last one
+static std::shared_ptr<BasicMsg> deliver(MessageSink & sink) {
+    while (CommLayer::getInstance().availableMessages())
+        CommLayer::getInstance().processNextMessage();
+    return sink.msgs.empty() ? std::shared_ptr<BasicMsg>() : sink.msgs.back();
+}
+
+
 /// Test functions
 BOOST_AUTO_TEST_SUITE(DispatcherTestSuite)
 
@@ -33,4 +80,55 @@ BOOST_AUTO_TEST_SUITE(DispatcherTestSuite)
 BOOST_AUTO_TEST_CASE(testTaskBagDispatcher) {
 }
 
+
+/// Changes with a base that the receiver does not have make it request the whole information
+BOOST_AUTO_TEST_CASE(testUpdateRequest) {
+    TestHost::getInstance().reset();
+    ConfigurationManager::getInstance().setUpdateBandwidth(0.0);
+    ConfigurationManager::getInstance().setDeltaUpdates(8);
+    MessageSink * sink = new MessageSink;
+    CommLayer::getInstance().registerService(sink);
+    CommAddress local = CommLayer::getInstance().getLocalAddress(), a("10.0.0.1", 2030), b("10.0.0.2", 2030);
+
+    // The sender sends its information to the local address, where the receiver has its left child
+    FixedBranch senderBranch(local, a, b), receiverBranch(CommAddress(), local, b);
+    TestDispatcher sender(senderBranch), receiver(receiverBranch);
+    IBPAvailabilityInformation info;
+    for (int i = 0; i < 20; ++i)
+        info.addNode(256 + i * 64, 1024 + i * 128);
+    info.setSeq(1);
+    sender.handle(a, info);
+    std::shared_ptr<BasicMsg> full = deliver(*sink);
+    BOOST_REQUIRE(dynamic_cast<IBPAvailabilityInformation *>(full.get()));
+    receiver.handle(local, static_cast<const IBPAvailabilityInformation &>(*full));
+    BOOST_CHECK_EQUAL(receiver.getChildInfo(0)->getSeq(), 1U);
+
+    // The first changes are lost, so the next ones do not apply
+    info.addNode(512, 2048);
+    info.setSeq(2);
+    sender.handle(a, info);
+    BOOST_REQUIRE(dynamic_cast<IBPAvailabilityDelta *>(deliver(*sink).get()));
+    info.addNode(768, 1536);
+    info.setSeq(3);
+    sender.handle(a, info);
+    std::shared_ptr<BasicMsg> delta = deliver(*sink);
+    BOOST_REQUIRE(dynamic_cast<IBPAvailabilityDelta *>(delta.get()));
+    BOOST_CHECK_EQUAL(static_cast<IBPAvailabilityDelta &>(*delta).getBaseSeq(), 2U);
+    receiver.handle(local, static_cast<const IBPAvailabilityDelta &>(*delta));
+    std::shared_ptr<BasicMsg> request = deliver(*sink);
+    BOOST_REQUIRE(dynamic_cast<UpdateRequestMsg *>(request.get()));
+    BOOST_CHECK_EQUAL(receiver.getChildInfo(0)->getSeq(), 1U);
+
+    // The sender answers with the whole information, which the receiver takes
+    sender.handle(local, static_cast<const UpdateRequestMsg &>(*request));
+    full = deliver(*sink);
+    BOOST_REQUIRE(dynamic_cast<IBPAvailabilityInformation *>(full.get()));
+    receiver.handle(local, static_cast<const IBPAvailabilityInformation &>(*full));
+    std::shared_ptr<IBPAvailabilityInformation> received =
+            std::static_pointer_cast<IBPAvailabilityInformation>(receiver.getChildInfo(0));
+    BOOST_CHECK_EQUAL(received->getSeq(), static_cast<IBPAvailabilityInformation &>(*full).getSeq());
+    BOOST_CHECK(*received == static_cast<IBPAvailabilityInformation &>(*full));
+    BOOST_CHECK_EQUAL(sink->msgs.size(), 5U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -19,10 +19,15 @@
  */
 
 #include <sstream>
+#include <algorithm>
+#include <memory>
+#include <array>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include "CheckMsg.hpp"
 #include "TestHost.hpp"
 #include "FSPAvailabilityInformation.hpp"
+#include "FSPFunctionVector.hpp"
 #include "../RandomQueueGenerator.hpp"
 using namespace std;
 
@@ -37,6 +42,49 @@ struct FSPAvailabilityInfoFixture {
     FSPAvailabilityInformation s1;
 };
 
+/// Allocation of tasks to a FunctionVector
+struct Allocation {
+    std::vector<int> tasks;
+    std::vector<double> slowness;
+    double minSlowness;
+};
+
+
+/// The allocation of computeTasksPerFunction before it skipped the full rounds, one heap per round
+static Allocation referenceAllocation(const FSPDispatcher::FunctionVector & functions, const std::array<double, 2> & branchSlowness,
+        unsigned int numTasksReq, uint64_t a) {
+    Allocation result;
+    result.tasks.assign(functions.size(), 0);
+    result.slowness.assign(functions.size(), INFINITY);
+    result.minSlowness = 0.0;
+    auto compare = [](const std::pair<double, size_t> & l, const std::pair<double, size_t> & r) { return l.first > r.first; };
+    unsigned int totalTasks = 0;
+    for (int currentTpn = 1; totalTasks < numTasksReq; ++currentTpn) {
+        std::vector<std::pair<double, size_t> > slownessHeap;
+        for (size_t i = 0; i < functions.size(); ++i) {
+            const FSPDispatcher::FunctionInfo & func = functions[i];
+            double slowness = currentTpn == 1 ?
+                    func.cluster->getMaximumSlowness().getSlowness(a)
+                    : func.cluster->getMaximumSlowness().estimateSlowness(a, currentTpn);
+            if (slowness < branchSlowness[func.child]) {
+                slowness = branchSlowness[func.child];
+            }
+            slownessHeap.push_back(std::make_pair(slowness, i));
+            std::push_heap(slownessHeap.begin(), slownessHeap.end(), compare);
+        }
+        while (!slownessHeap.empty() && totalTasks < numTasksReq) {
+            std::pop_heap(slownessHeap.begin(), slownessHeap.end(), compare);
+            size_t i = slownessHeap.back().second;
+            result.tasks[i]++;
+            result.minSlowness = result.slowness[i] = slownessHeap.back().first;
+            totalTasks += functions[i].cluster->getValue();
+            slownessHeap.pop_back();
+        }
+    }
+    return result;
+}
+
+
 BOOST_FIXTURE_TEST_SUITE(FSPAvailabilityInfoTest, FSPAvailabilityInfoFixture)
 
 
@@ -51,6 +99,279 @@ BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_checkMsg) {
     CheckMsgMethod::check(s1, p);
 }
 
+
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_getFunctions) {
+    RandomQueueGenerator gen;
+    for (int i = 0; i < 50; ++i) {
+        FSPTaskList proxys(gen.createRandomQueue(1000.0));
+        proxys.sortMinSlowness();
+        FSPAvailabilityInformation node;
+        node.setAvailability(256 + (i * 7) % 11 * 128, 256 + (i * 5) % 13 * 64, proxys, 1000.0);
+        s1.join(node);
+    }
+    TaskDescription req;
+    for (uint32_t m : {0, 512, 1024, 4096}) {
+        for (uint32_t d : {0, 512, 1024}) {
+            req.setMaxMemory(m);
+            req.setMaxDisk(d);
+            std::list<const FSPAvailabilityInformation::MDZCluster *> expected;
+            for (auto & c : s1.getSummary())
+                if (c.fulfills(req))
+                    expected.push_back(&c);
+            BOOST_CHECK(s1.getFunctions(req) == expected);
+        }
+    }
+
+    // Remove the clusters with enough memory, the rest must remain in the same order
+    req.setMaxMemory(1024);
+    req.setMaxDisk(0);
+    std::list<const FSPAvailabilityInformation::MDZCluster *> removed = s1.getFunctions(req);
+    std::vector<int32_t> remaining;
+    for (auto & c : s1.getSummary())
+        if (!c.fulfills(req))
+            remaining.push_back(c.getTotalMemory());
+    s1.removeClusters(removed);
+    BOOST_REQUIRE_EQUAL(s1.getSummary().size(), remaining.size());
+    for (size_t i = 0; i < remaining.size(); ++i)
+        BOOST_CHECK_EQUAL(s1.getSummary()[i].getTotalMemory(), remaining[i]);
+    BOOST_CHECK(s1.getFunctions(req).empty());
+    req.setMaxMemory(0);
+    BOOST_CHECK_EQUAL(s1.getFunctions(req).size(), remaining.size());
+}
+
+
+/// Skipping the full rounds allocates the same tasks as one heap per round, also with ties
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_computeTasksPerFunction) {
+    for (unsigned int seed : {1U, 2U, 3U, 4U, 5U}) {
+        RandomQueueGenerator gen(seed);
+        FSPAvailabilityInformation info[2];
+        std::list<const FSPAvailabilityInformation::MDZCluster *> clusters[2];
+        std::array<double, 2> branchSlowness;
+        for (int c : {0, 1}) {
+            for (int i = 0; i < 10; ++i) {
+                double power = gen.getRandomPower();
+                FSPTaskList proxys(gen.createRandomQueue(power));
+                proxys.sortMinSlowness();
+                FSPAvailabilityInformation node;
+                node.setAvailability(256 + i % 3 * 128, 256, proxys, power);
+                // Repeated nodes, with the same slowness
+                for (int r = 0; r <= i % 3; ++r)
+                    info[c].join(node);
+            }
+            clusters[c] = info[c].getFunctions(TaskDescription());
+            branchSlowness[c] = info[c].getMinimumSlowness();
+        }
+        // Functions under the slowness of their branch all tie with it
+        for (double bs : {branchSlowness[1], info[1].getMaximumSlowness()}) {
+            branchSlowness[1] = bs;
+            FSPDispatcher::FunctionVector base(clusters, branchSlowness);
+            for (unsigned int numTasks : {1U, base.getTotalNodes() - 1, base.getTotalNodes(), 3 * base.getTotalNodes() + 7}) {
+                for (uint64_t a : {10000ULL, 1000000ULL}) {
+                    FSPDispatcher::FunctionVector functions(clusters, branchSlowness);
+                    functions.computeTasksPerFunction(numTasks, a);
+                    Allocation reference = referenceAllocation(base, branchSlowness, numTasks, a);
+                    BOOST_CHECK_EQUAL(functions.getMinimumSlowness(), reference.minSlowness);
+                    for (size_t i = 0; i < functions.size(); ++i) {
+                        BOOST_CHECK_EQUAL(functions[i].tasks, reference.tasks[i]);
+                        BOOST_CHECK_EQUAL(functions[i].slowness, reference.slowness[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/// Copies share the clusters, and removing them from one copy leaves the others untouched
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_sharedSummary) {
+    RandomQueueGenerator gen;
+    FSPAvailabilityInformation left, right;
+    for (int i = 0; i < 20; ++i) {
+        FSPTaskList proxys(gen.createRandomQueue(1000.0));
+        proxys.sortMinSlowness();
+        FSPAvailabilityInformation node;
+        node.setAvailability(256 + (i * 7) % 11 * 128, 256 + (i * 5) % 13 * 64, proxys, 1000.0);
+        (i % 2 ? right : left).join(node);
+    }
+    s1.join(left);
+    s1.join(right);
+    std::vector<FSPAvailabilityInformation::MDZCluster> expected(left.getSummary().begin(), left.getSummary().end());
+    expected.insert(expected.end(), right.getSummary().begin(), right.getSummary().end());
+    BOOST_REQUIRE_EQUAL(s1.getSummary().size(), expected.size());
+    BOOST_CHECK(std::equal(expected.begin(), expected.end(), s1.getSummary().begin()));
+
+    // The clusters are found in the original and removed from the copy
+    std::unique_ptr<FSPAvailabilityInformation> copy(s1.clone());
+    TaskDescription req;
+    req.setMaxMemory(1024);
+    req.setMaxDisk(0);
+    std::list<const FSPAvailabilityInformation::MDZCluster *> removed = s1.getFunctions(req);
+    BOOST_REQUIRE(!removed.empty());
+    copy->removeClusters(removed);
+    BOOST_CHECK_EQUAL(copy->getSummary().size(), expected.size() - removed.size());
+    BOOST_CHECK(copy->getFunctions(req).empty());
+    BOOST_REQUIRE_EQUAL(s1.getSummary().size(), expected.size());
+    BOOST_CHECK(std::equal(expected.begin(), expected.end(), s1.getSummary().begin()));
+    BOOST_CHECK(s1.getFunctions(req) == removed);
+    BOOST_CHECK(std::equal(expected.begin(), expected.begin() + left.getSummary().size(), left.getSummary().begin()));
+}
+
+
+/// Reducing incrementally gives the clusters of the previous reduction that did not change
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_reduceIncrementally) {
+    RandomQueueGenerator gen;
+    FSPAvailabilityInformation left, right;
+    for (int i = 0; i < 20; ++i) {
+        FSPTaskList proxys(gen.createRandomQueue(1000.0));
+        proxys.sortMinSlowness();
+        FSPAvailabilityInformation node;
+        node.setAvailability(256 + (i * 7) % 11 * 128, 256 + (i * 5) % 13 * 64, proxys, 1000.0);
+        (i % 2 ? right : left).join(node);
+    }
+    s1.join(left);
+    s1.join(right);
+    FSPAvailabilityInformation::setNumClusters(8);
+
+    // From scratch, it is the same as reduce
+    FSPAvailabilityInformation::Reduction reduction;
+    std::unique_ptr<FSPAvailabilityInformation> first(s1.clone()), expected(s1.clone());
+    first->reduce(reduction);
+    expected->reduce();
+    BOOST_CHECK(first->getSummary() == expected->getSummary());
+    BOOST_CHECK_EQUAL(reduction.getSteps(), 0U);
+
+    // The same clusters, even in a different chunk, give the same result without clustering again
+    std::unique_ptr<FSPAvailabilityInformation> sameLeft(left.clone());
+    sameLeft->setSummary(std::vector<FSPAvailabilityInformation::MDZCluster>(left.getSummary().begin(), left.getSummary().end()));
+    std::unique_ptr<FSPAvailabilityInformation> same(sameLeft->clone());
+    same->join(right);
+    same->reduce(reduction);
+    BOOST_CHECK(same->getSummary() == first->getSummary());
+    BOOST_CHECK_EQUAL(reduction.getSteps(), 1U);
+
+    // The new left summary loses the clusters with more memory and gets a new node
+    std::unique_ptr<FSPAvailabilityInformation> newLeft(left.clone());
+    TaskDescription req;
+    req.setMaxMemory(1024);
+    req.setMaxDisk(0);
+    newLeft->removeClusters(newLeft->getFunctions(req));
+    FSPTaskList proxys(gen.createRandomQueue(1000.0));
+    proxys.sortMinSlowness();
+    FSPAvailabilityInformation node;
+    node.setAvailability(2048, 1024, proxys, 1000.0);
+    newLeft->join(node);
+    std::unique_ptr<FSPAvailabilityInformation> joined(newLeft->clone());
+    joined->join(right);
+    std::unique_ptr<FSPAvailabilityInformation> next(joined->clone());
+    next->reduce(reduction);
+    BOOST_CHECK_EQUAL(reduction.getSteps(), 2U);
+    BOOST_CHECK(next->getSummary().size() <= 8U);
+    unsigned int nodes = 0, expectedNodes = 0;
+    for (auto & c : next->getSummary())
+        nodes += c.getValue();
+    for (auto & c : joined->getSummary())
+        expectedNodes += c.getValue();
+    BOOST_CHECK_EQUAL(nodes, expectedNodes);
+    // The bounds are those of the joined information, not patched
+    expected.reset(joined->clone());
+    expected->reduce();
+    BOOST_CHECK_EQUAL(next->getMinimumSlowness(), expected->getMinimumSlowness());
+    BOOST_CHECK_EQUAL(next->getMaximumSlowness(), expected->getMaximumSlowness());
+
+    // Once cleared, it is reduced from scratch again
+    reduction.clear();
+    next.reset(joined->clone());
+    next->reduce(reduction);
+    BOOST_CHECK(next->getSummary() == expected->getSummary());
+    BOOST_CHECK_EQUAL(reduction.getSteps(), 0U);
+    FSPAvailabilityInformation::setNumClusters(125);
+}
+
+
+/// Filling the lists of nearest clusters with several threads gives the same clusters as with one
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_reduceThreads) {
+    RandomQueueGenerator gen;
+    for (int i = 0; i < 200; ++i) {
+        FSPTaskList proxys(gen.createRandomQueue(1000.0));
+        proxys.sortMinSlowness();
+        FSPAvailabilityInformation node;
+        node.setAvailability(256 + (i * 7) % 11 * 128, 256 + (i * 5) % 13 * 64, proxys, 1000.0);
+        s1.join(node);
+    }
+    FSPAvailabilityInformation::setNumClusters(8);
+    std::unique_ptr<FSPAvailabilityInformation> expected(s1.clone());
+    expected->reduce();
+    // The workers are reused by the following reductions
+    ClusteringList<FSPAvailabilityInformation::MDZCluster>::setNumThreads(4);
+    for (int i = 0; i < 3; ++i) {
+        std::unique_ptr<FSPAvailabilityInformation> result(s1.clone());
+        result->reduce();
+        BOOST_CHECK(result->getSummary() == expected->getSummary());
+    }
+    ClusteringList<FSPAvailabilityInformation::MDZCluster>::setNumThreads(1);
+    FSPAvailabilityInformation::setNumClusters(125);
+}
+
+/// Applying the changes between two summaries to the first one gives the clusters of the second one
+BOOST_AUTO_TEST_CASE(FSPAvailabilityInfo_delta) {
+    RandomQueueGenerator gen;
+    for (int i = 0; i < 30; ++i) {
+        FSPTaskList proxys(gen.createRandomQueue(1000.0));
+        proxys.sortMinSlowness();
+        FSPAvailabilityInformation node;
+        node.setAvailability(256 + (i * 7) % 11 * 128, 256 + (i * 5) % 13 * 64, proxys, 1000.0);
+        s1.join(node);
+    }
+    s1.setSeq(3);
+
+    // The next version loses the clusters with more memory and gets a new node
+    std::unique_ptr<FSPAvailabilityInformation> next(s1.clone());
+    TaskDescription req;
+    req.setMaxMemory(1024);
+    req.setMaxDisk(0);
+    next->removeClusters(next->getFunctions(req));
+    FSPTaskList proxys(gen.createRandomQueue(1000.0));
+    proxys.sortMinSlowness();
+    FSPAvailabilityInformation node;
+    node.setAvailability(2048, 1024, proxys, 1000.0);
+    next->join(node);
+    next->setSeq(4);
+
+    FSPAvailabilityDelta delta(s1, *next);
+    BOOST_CHECK_EQUAL(delta.getBaseSeq(), 3U);
+    BOOST_CHECK_EQUAL(delta.getSeq(), 4U);
+    std::shared_ptr<FSPAvailabilityDelta> copy;
+    unsigned int deltaSize = CheckMsgMethod::check(delta, copy);
+    BOOST_CHECK(deltaSize < next->packedSize());
+
+    std::unique_ptr<FSPAvailabilityInformation> result(copy->apply(s1));
+    BOOST_REQUIRE(result.get());
+    BOOST_CHECK_EQUAL(result->getSeq(), 4U);
+    // The same clusters in the same order, so that ties are broken in the same way
+    BOOST_CHECK(result->getSummary() == next->getSummary());
+    BOOST_CHECK_EQUAL(result->getMinimumSlowness(), next->getMinimumSlowness());
+    BOOST_CHECK_EQUAL(result->getMaximumSlowness(), next->getMaximumSlowness());
+    std::list<const FSPAvailabilityInformation::MDZCluster *> resultFunctions = result->getFunctions(req), nextFunctions = next->getFunctions(req);
+    BOOST_REQUIRE_EQUAL(resultFunctions.size(), nextFunctions.size());
+    BOOST_CHECK(std::equal(resultFunctions.begin(), resultFunctions.end(), nextFunctions.begin(),
+            [](const FSPAvailabilityInformation::MDZCluster * l, const FSPAvailabilityInformation::MDZCluster * r) { return *l == *r; }));
+
+    // A reordered summary is rebuilt in its own order
+    std::vector<FSPAvailabilityInformation::MDZCluster> reversed(next->getSummary().begin(), next->getSummary().end());
+    std::reverse(reversed.begin(), reversed.end());
+    FSPAvailabilityInformation reordered(*next);
+    reordered.setSummary(std::move(reversed));
+    std::unique_ptr<FSPAvailabilityInformation> reorderedResult(FSPAvailabilityDelta(*next, reordered).apply(*next));
+    BOOST_REQUIRE(reorderedResult.get());
+    BOOST_CHECK(reorderedResult->getSummary() == reordered.getSummary());
+
+    // Without changes, only the sequence number is sent
+    FSPAvailabilityDelta same(*result, *next);
+    BOOST_CHECK(!same.hasHeader());
+    std::unique_ptr<FSPAvailabilityInformation> sameResult(same.apply(*result));
+    BOOST_CHECK(*sameResult == *result);
+}
+
 BOOST_AUTO_TEST_SUITE_END()   // FSPAvailabilityInfoTest
 
 } // namespace stars
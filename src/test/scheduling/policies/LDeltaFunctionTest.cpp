@@ -36,7 +36,7 @@ string plot(LDeltaFunction & f) {
         os << "0,0" << endl;
         os << "100000000000," << (unsigned long)(f.getSlope() * 100000.0) << endl;
     } else {
-        for (vector<pair<Time, double> >::const_iterator it = f.getPoints().begin(); it != f.getPoints().end(); it++)
+        for (LDeltaFunction::PieceVector::const_iterator it = f.getPoints().begin(); it != f.getPoints().end(); it++)
             os << it->first.getRawDate() << ',' << it->second << endl;
     }
     return os.str();
@@ -67,6 +67,18 @@ BOOST_AUTO_TEST_CASE(LDeltaFunction_create) {
 }
 
 
+BOOST_AUTO_TEST_CASE(LDeltaFunction_packedSize) {
+    for (int i = 0; i < 10; ++i) {
+        double power = rqg.getRandomPower();
+        LDeltaFunction f(power, rqg.createRandomQueue(power));
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> pk(&buffer);
+        pk.pack(f);
+        BOOST_CHECK_EQUAL(f.packedSize(), buffer.size());
+    }
+}
+
+
 BOOST_AUTO_TEST_CASE(LDeltaFunction_min) {
     double f1power = rqg.getRandomPower(), f2power = rqg.getRandomPower();
     LDeltaFunction f1(f1power, rqg.createNLengthQueue(20, f1power)),
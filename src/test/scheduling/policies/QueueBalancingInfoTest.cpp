@@ -19,9 +19,14 @@
  */
 
 #include <memory>
+#include <list>
 #include <boost/test/unit_test.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
 #include "CheckMsg.hpp"
+#include "TestHost.hpp"
 #include "MMPAvailabilityInformation.hpp"
+using namespace std;
 
 
 BOOST_AUTO_TEST_SUITE(Cor)   // Correctness test suite
@@ -39,6 +44,66 @@ BOOST_AUTO_TEST_CASE(qbiMsg) {
     CheckMsgMethod::check(e, p);
 }
 
+
+/// The search that getAvailability did before the queue index, with one scan per deadline
+static Time linearSearch(MMPAvailabilityInformation & info, list<const MMPAvailabilityInformation::MDPTCluster *> & clusters,
+        unsigned int numTasks, const TaskDescription & req) {
+    TaskDescription tmp(req);
+    Time max = Time::getCurrentTime(), min;
+    int64_t d = 300000000;
+    unsigned int t = 0;
+    while (t < numTasks && d < 1000000000000000000L) {
+        clusters.clear();
+        min = max;
+        max += Duration(d);
+        d *= 2;
+        tmp.setDeadline(max);
+        t = info.getAvailability(clusters, tmp);
+    }
+    unsigned int last = 0;
+    while (last != t) {
+        clusters.clear();
+        last = t;
+        d /= 2;
+        Time med = min + Duration(d);
+        tmp.setDeadline(med);
+        t = info.getAvailability(clusters, tmp);
+        if (t < numTasks) min = med;
+        else max = med;
+    }
+    return max;
+}
+
+
+/// Balanced queue search with the queue index
+BOOST_AUTO_TEST_CASE(qbiBalancedQueue) {
+    TestHost::getInstance().reset();
+    boost::random::mt19937 gen(12345);
+    Time now = Time::getCurrentTime();
+
+    for (int i = 0; i < 20; ++i) {
+        MMPAvailabilityInformation info;
+        for (int j = 0; j < 100; ++j) {
+            MMPAvailabilityInformation node;
+            node.setQueueEnd(boost::random::uniform_int_distribution<>(256, 4096)(gen),
+                    boost::random::uniform_int_distribution<>(256, 4096)(gen),
+                    boost::random::uniform_int_distribution<>(50, 3000)(gen),
+                    now + Duration(boost::random::uniform_int_distribution<int64_t>(-3600000000LL, 36000000000LL)(gen)));
+            info.join(node);
+        }
+        TaskDescription req;
+        req.setMaxMemory(boost::random::uniform_int_distribution<>(0, 2048)(gen));
+        req.setMaxDisk(boost::random::uniform_int_distribution<>(0, 2048)(gen));
+        req.setLength(boost::random::uniform_int_distribution<>(1000, 1000000)(gen));
+        unsigned int numTasks = boost::random::uniform_int_distribution<>(1, 10000)(gen);
+
+        list<const MMPAvailabilityInformation::MDPTCluster *> expected, result;
+        Time expectedQueue = linearSearch(info, expected, numTasks, req);
+        BOOST_CHECK_EQUAL(info.getAvailability(result, numTasks, req), expectedQueue);
+        BOOST_CHECK(result == expected);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()   // aiTS
 
 BOOST_AUTO_TEST_SUITE_END()   // Cor
@@ -193,6 +193,17 @@ BOOST_AUTO_TEST_CASE(ZAFunction_moveassign) {
 }
 
 
+BOOST_AUTO_TEST_CASE(ZAFunction_packedSize) {
+    for (int i = 0; i < 10; ++i) {
+        f.createRandomFunction();
+        msgpack::sbuffer buffer;
+        msgpack::packer<msgpack::sbuffer> pk(&buffer);
+        pk.pack(f.function);
+        BOOST_CHECK_EQUAL(f.function.packedSize(), buffer.size());
+    }
+}
+
+
 BOOST_AUTO_TEST_CASE(ZAFunction_estimateSlowness) {
     f.createNTaskFunction(20);
     forAinDomain(f.horizon, [&] (uint64_t a) {
@@ -214,12 +225,33 @@ BOOST_AUTO_TEST_CASE(ZAFunction_estimateSlowness) {
 }
 
 
+BOOST_AUTO_TEST_CASE(ZAFunction_slownessBatch) {
+    vector<ZAFunction> functions(10);
+    vector<const ZAFunction *> pointers;
+    for (auto & i : functions) {
+        f.createRandomFunction();
+        i = f.function;
+        pointers.push_back(&i);
+    }
+    ZAFunction::SlownessBatch batch;
+    double result[10];
+    forAinDomain(f.horizon, [&] (uint64_t a) {
+        batch.select(pointers, a);
+        for (unsigned int n : {1, 2, 5}) {
+            batch.evaluate(n, result);
+            for (size_t i = 0; i < functions.size(); ++i)
+                BOOST_CHECK_EQUAL(result[i], n == 1 ? functions[i].getSlowness(a) : functions[i].estimateSlowness(a, n));
+        }
+    } );
+}
+
+
 BOOST_AUTO_TEST_CASE(ZAFunction_continuity) {
     //rqg.seed(1371628638);
     for (int i = 0; i < 100; ++i) {
         f.createNTaskFunction(20);
         const ZAFunction::PieceVector & pieces = f.function.getPieces();
-        for (auto i = ++pieces.begin(); i != pieces.end(); ++i) {
+        for (auto i = pieces.begin() + 1; i != pieces.end(); ++i) {
             auto prev = i;
             --prev;
             BOOST_CHECK_CLOSE(prev->value(i->leftEndpoint), i->value(i->leftEndpoint), 0.1);
@@ -274,6 +306,21 @@ BOOST_AUTO_TEST_CASE(ZAFunction_reduceMax) {
 }
 
 
+BOOST_AUTO_TEST_CASE(ZAFunction_inlineCopy) {
+    ZAFunction::setNumPieces(3);
+    f.createNTaskFunction(20);
+    ZAFunction fred(f.function);
+    fred.reduceMax(f.horizon, 10);
+    // Copying a reduced function must not allocate memory
+    unsigned long int allocations = ZAFunction::PieceVector::getHeapAllocations();
+    ZAFunction copy(fred);
+    BOOST_CHECK_EQUAL(copy, fred);
+    copy = fred;
+    BOOST_CHECK_EQUAL(copy, fred);
+    BOOST_CHECK_EQUAL(ZAFunction::PieceVector::getHeapAllocations(), allocations);
+}
+
+
 BOOST_AUTO_TEST_CASE(ZAFunction_plotSampled) {
     Time now = TestHost::getInstance().getCurrentTime();
     ofstream ofs("laf_test.stat");